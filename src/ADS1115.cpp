@@ -34,13 +34,37 @@ THE SOFTWARE.
 */
 
 #include "ADS1115.h"
+#include <wiringPi.h>
 #include <wiringPiI2C.h>
+#include "Trace.h"
+#include "Timing.h"
 #include <iostream>
+#include <unistd.h>
+
+static ADS1115* s_AlertPinOwners[ADS1115_MAX_ALERT_PIN];
+
+/* wiringPiISR() handlers take no argument, so every pin gets its own trampoline */
+template<int PIN> static void conversionReadyIsr() {
+    if (s_AlertPinOwners[PIN]) {
+        s_AlertPinOwners[PIN]->handleConversionReady();
+    }
+}
+
+template<int N> struct ConversionReadyIsrTable {
+    static void fill(void (**table)(void)) {
+        ConversionReadyIsrTable<N - 1>::fill(table);
+        table[N - 1] = &conversionReadyIsr<N - 1>;
+    }
+};
+
+template<> struct ConversionReadyIsrTable<0> {
+    static void fill(void (**)(void)) {}
+};
 
 /** Default constructor, uses default I2C address.
  * @see ADS1115_DEFAULT_ADDRESS
  */
-ADS1115::ADS1115() {
+ADS1115::ADS1115() : m_Address(ADS1115_DEFAULT_ADDRESS), m_Config(ADS1115_CFG_SHADOW_DEFAULT), m_Staging(false), m_AlertPin(-1), m_ReadyCount(0), m_StartCount(0), m_ReadyTime(0) {
     m_Fd = wiringPiI2CSetup(ADS1115_DEFAULT_ADDRESS / 2);
 }
 
@@ -52,7 +76,7 @@ ADS1115::ADS1115() {
  * @see ADS1115_ADDRESS_ADDR_SDA
  * @see ADS1115_ADDRESS_ADDR_SDL
  */
-ADS1115::ADS1115(uint8_t address) {
+ADS1115::ADS1115(uint8_t address) : m_Address(address), m_Config(ADS1115_CFG_SHADOW_DEFAULT), m_Staging(false), m_AlertPin(-1), m_ReadyCount(0), m_StartCount(0), m_ReadyTime(0) {
     m_Fd = wiringPiI2CSetup(address / 2);
 }
 
@@ -61,8 +85,10 @@ ADS1115::ADS1115(uint8_t address) {
  * single-shot read mode, P0/N1 mux, 2.048v gain, 128 samples/sec, default
  * comparator with hysterysis, active-low polarity, non-latching comparator,
  * and comparater-disabled operation. 
+ * All fields are staged and sent to the device in a single CONFIG write.
  */
 void ADS1115::initialize() {
+  beginConfig();
   setMultiplexer(ADS1115_MUX_P0_N1);
   setGain(ADS1115_PGA_2P048);
   setMode(ADS1115_MODE_SINGLESHOT);
@@ -71,6 +97,33 @@ void ADS1115::initialize() {
   setComparatorPolarity(ADS1115_COMP_POL_ACTIVE_LOW);
   setComparatorLatchEnabled(ADS1115_COMP_LAT_NON_LATCHING);
   setComparatorQueueMode(ADS1115_COMP_QUE_DISABLE);
+  commitConfig();
+}
+
+/** Start staging CONFIG fields.
+ * Until commitConfig() is called the CONFIG setters only update the shadow
+ * copy of the register, so a complete reconfiguration (and the conversion
+ * trigger) costs a single 16-bit write.
+ * @see commitConfig()
+ */
+void ADS1115::beginConfig() {
+    m_Staging = true;
+}
+
+/** Write the shadow CONFIG register to the device and stop staging.
+ * The OS bit only triggers a conversion when written, so it is cleared from
+ * the shadow copy afterwards.
+ * @return True if the write succeeded
+ * @see beginConfig()
+ */
+bool ADS1115::commitConfig() {
+    m_Staging = false;
+    if (m_Config & (1 << ADS1115_CFG_OS_BIT)) {
+        m_StartCount = __atomic_load_n(&m_ReadyCount, __ATOMIC_RELAXED);
+    }
+    bool ret = writeRegister(ADS1115_RA_CONFIG, m_Config);
+    m_Config &= ~(1 << ADS1115_CFG_OS_BIT);
+    return ret;
 }
 
 /** Verify the I2C connection.
@@ -78,6 +131,7 @@ void ADS1115::initialize() {
  * @return True if connection is valid, false otherwise
  */
 bool ADS1115::testConnection() {
+    TraceScope trace(TRACE_I2C_READ, m_Address);
     return wiringPiI2CReadReg16(m_Fd, ADS1115_RA_CONVERSION) != - 1;
 }
 
@@ -88,8 +142,82 @@ bool ADS1115::testConnection() {
  */
 void ADS1115::waitBusy(uint16_t max_retries) {  
   for(uint16_t i = 0; i < max_retries; i++) {
-    if (getOpStatus()==ADS1115_OS_INACTIVE) break;
+    if (conversionReady()) break;
+    if (m_AlertPin >= 0) usleep(100);
+  }
+}
+
+/** Check whether the last triggered conversion has finished.
+ * With an ALERT/RDY pin attached this only looks at the edge count recorded
+ * by the interrupt handler, otherwise the OS bit is polled over I2C.
+ * @return True when the conversion result is available
+ * @see enableConversionReadyPin()
+ */
+bool ADS1115::conversionReady() {
+  if (m_AlertPin >= 0) {
+    return __atomic_load_n(&m_ReadyCount, __ATOMIC_ACQUIRE) != m_StartCount;
   }
+  return getOpStatus() == ADS1115_OS_INACTIVE;
+}
+
+/** Use the ALERT/RDY pin as conversion-ready signal.
+ * Setting the MSB of Hi_thresh and clearing it in Lo_thresh turns the
+ * comparator into a conversion-ready output, the active-low pin then falls
+ * at the end of every conversion. wiringPiSetupGpio() must have been called.
+ * @param pin GPIO the ALERT/RDY pin is wired to
+ * @return True if the edge handler could be installed
+ */
+bool ADS1115::enableConversionReadyPin(int pin) {
+  static void (*isrTable[ADS1115_MAX_ALERT_PIN])(void);
+  if (!isrTable[0]) {
+    ConversionReadyIsrTable<ADS1115_MAX_ALERT_PIN>::fill(isrTable);
+  }
+  if (pin < 0 || pin >= ADS1115_MAX_ALERT_PIN) {
+    return false;
+  }
+
+  setHighThreshold((int16_t)0x8000);
+  setLowThreshold(0x0000);
+  beginConfig();
+  setComparatorPolarity(ADS1115_COMP_POL_ACTIVE_LOW);
+  setComparatorLatchEnabled(ADS1115_COMP_LAT_NON_LATCHING);
+  setComparatorQueueMode(ADS1115_COMP_QUE_ASSERT1);
+  commitConfig();
+
+  pinMode(pin, INPUT);
+  pullUpDnControl(pin, PUD_UP);
+  s_AlertPinOwners[pin] = this;
+  if (wiringPiISR(pin, INT_EDGE_FALLING, isrTable[pin]) < 0) {
+    s_AlertPinOwners[pin] = 0;
+    return false;
+  }
+  m_AlertPin = pin;
+  return true;
+}
+
+/** Get the GPIO used as conversion-ready signal.
+ * @return GPIO number, or -1 when the OS bit is polled instead
+ */
+int ADS1115::getConversionReadyPin() {
+  return m_AlertPin;
+}
+
+/** Get the time the last conversion finished.
+ * Only available with a conversion-ready pin, the timestamp is taken in the
+ * edge handler from CLOCK_MONOTONIC.
+ * @return Completion time, zero if no conversion has been signalled yet
+ */
+struct timespec ADS1115::getConversionTime() {
+  return nsToTimespec(__atomic_load_n(&m_ReadyTime, __ATOMIC_ACQUIRE));
+}
+
+/** Record the end of a conversion.
+ * Runs in the wiringPi interrupt thread. The timestamp is stored before the
+ * edge count is released, so readers seeing the new count also see its time.
+ */
+void ADS1115::handleConversionReady() {
+  __atomic_store_n(&m_ReadyTime, monotonicNs(), __ATOMIC_RELAXED);
+  __atomic_fetch_add(&m_ReadyCount, 1, __ATOMIC_RELEASE);
 }
 
 
@@ -130,7 +258,7 @@ void ADS1115::waitBusy(uint16_t max_retries) {
  */
 int16_t ADS1115::getConversion() {
 #if 0
-    if (devMode == ADS1115_MODE_SINGLESHOT) 
+    if (getMode() == ADS1115_MODE_SINGLESHOT) 
     {  
       setOpStatus(ADS1115_OS_ACTIVE);
       ADS1115::waitBusy(1000);
@@ -148,7 +276,7 @@ int16_t ADS1115::getConversion() {
  * @see getConversion()
  */
 int16_t ADS1115::getConversionP0N1() {
-    if (muxMode != ADS1115_MUX_P0_N1) setMultiplexer(ADS1115_MUX_P0_N1);
+    if (getMultiplexer() != ADS1115_MUX_P0_N1) setMultiplexer(ADS1115_MUX_P0_N1);
     return getConversion();
 }
 
@@ -160,7 +288,7 @@ int16_t ADS1115::getConversionP0N1() {
  * @see getConversion()
  */
 int16_t ADS1115::getConversionP0N3() {
-    if (muxMode != ADS1115_MUX_P0_N3) setMultiplexer(ADS1115_MUX_P0_N3);
+    if (getMultiplexer() != ADS1115_MUX_P0_N3) setMultiplexer(ADS1115_MUX_P0_N3);
     return getConversion();
 }
 
@@ -172,7 +300,7 @@ int16_t ADS1115::getConversionP0N3() {
  * @see getConversion()
  */
 int16_t ADS1115::getConversionP1N3() {
-    if (muxMode != ADS1115_MUX_P1_N3) setMultiplexer(ADS1115_MUX_P1_N3);
+    if (getMultiplexer() != ADS1115_MUX_P1_N3) setMultiplexer(ADS1115_MUX_P1_N3);
     return getConversion();
 }
 
@@ -184,7 +312,7 @@ int16_t ADS1115::getConversionP1N3() {
  * @see getConversion()
  */
 int16_t ADS1115::getConversionP2N3() {
-    if (muxMode != ADS1115_MUX_P2_N3) setMultiplexer(ADS1115_MUX_P2_N3);
+    if (getMultiplexer() != ADS1115_MUX_P2_N3) setMultiplexer(ADS1115_MUX_P2_N3);
     return getConversion();
 }
 
@@ -196,7 +324,7 @@ int16_t ADS1115::getConversionP2N3() {
  * @see getConversion()
  */
 int16_t ADS1115::getConversionP0GND() {
-    if (muxMode != ADS1115_MUX_P0_NG) setMultiplexer(ADS1115_MUX_P0_NG);
+    if (getMultiplexer() != ADS1115_MUX_P0_NG) setMultiplexer(ADS1115_MUX_P0_NG);
     return getConversion();
 }
 /** Get AIN1/GND differential.
@@ -207,7 +335,7 @@ int16_t ADS1115::getConversionP0GND() {
  * @see getConversion()
  */
 int16_t ADS1115::getConversionP1GND() {
-    if (muxMode != ADS1115_MUX_P1_NG) setMultiplexer(ADS1115_MUX_P1_NG);
+    if (getMultiplexer() != ADS1115_MUX_P1_NG) setMultiplexer(ADS1115_MUX_P1_NG);
     return getConversion();
 }
 /** Get AIN2/GND differential.
@@ -218,7 +346,7 @@ int16_t ADS1115::getConversionP1GND() {
  * @see getConversion()
  */
 int16_t ADS1115::getConversionP2GND() {
-    if (muxMode != ADS1115_MUX_P2_NG) setMultiplexer(ADS1115_MUX_P2_NG);
+    if (getMultiplexer() != ADS1115_MUX_P2_NG) setMultiplexer(ADS1115_MUX_P2_NG);
     return getConversion();
 }
 /** Get AIN3/GND differential.
@@ -229,7 +357,7 @@ int16_t ADS1115::getConversionP2GND() {
  * @see getConversion()
  */
 int16_t ADS1115::getConversionP3GND() {
-    if (muxMode != ADS1115_MUX_P3_NG) setMultiplexer(ADS1115_MUX_P3_NG);
+    if (getMultiplexer() != ADS1115_MUX_P3_NG) setMultiplexer(ADS1115_MUX_P3_NG);
     return getConversion();
 }
 
@@ -240,7 +368,7 @@ int16_t ADS1115::getConversionP3GND() {
  *
  */
 float ADS1115::getMilliVolts() {
-  switch (pgaMode) { 
+  switch (getGain()) { 
     case ADS1115_PGA_6P144:
       return (getConversion() * ADS1115_MV_6P144);
       break;    
@@ -276,7 +404,15 @@ float ADS1115::getMilliVolts() {
  */
  
 float ADS1115::getMvPerCount() {
-  switch (pgaMode) {
+  return getMvPerCount(getGain());
+}
+
+/**
+ * Multiplier for a given PGA setting, for building conversion tables
+ * before the gain is actually programmed.
+ */
+float ADS1115::getMvPerCount(uint8_t gain) {
+  switch (gain) {
     case ADS1115_PGA_6P144:
       return ADS1115_MV_6P144;
       break;    
@@ -319,17 +455,17 @@ uint8_t ADS1115::getOpStatus() {
  * @see ADS1115_CFG_OS_BIT
  */
 void ADS1115::setOpStatus(uint8_t status) {
-    writeBitW(ADS1115_RA_CONFIG, ADS1115_CFG_OS_BIT, status);
+    setConfigBits(ADS1115_CFG_OS_BIT, 1, status);
 }
 /** Get multiplexer connection.
+ * Served from the shadow CONFIG register, no I2C transfer.
  * @return Current multiplexer connection setting
  * @see ADS1115_RA_CONFIG
  * @see ADS1115_CFG_MUX_BIT
  * @see ADS1115_CFG_MUX_LENGTH
  */
 uint8_t ADS1115::getMultiplexer() {
-    muxMode = (uint8_t)readBitsW(ADS1115_RA_CONFIG, ADS1115_CFG_MUX_BIT, ADS1115_CFG_MUX_LENGTH);
-    return muxMode;
+    return getConfigBits(ADS1115_CFG_MUX_BIT, ADS1115_CFG_MUX_LENGTH);
 }
 /** Set multiplexer connection.  Continous mode may fill the conversion register
  * with data before the MUX setting has taken effect.  A stop/start of the conversion
@@ -348,9 +484,8 @@ uint8_t ADS1115::getMultiplexer() {
  * @see ADS1115_CFG_MUX_LENGTH
  */
 void ADS1115::setMultiplexer(uint8_t mux) {
-    if (writeBitsW(ADS1115_RA_CONFIG, ADS1115_CFG_MUX_BIT, ADS1115_CFG_MUX_LENGTH, mux)) {
-        muxMode = mux;
-        if (devMode == ADS1115_MODE_CONTINUOUS) {
+    if (setConfigBits(ADS1115_CFG_MUX_BIT, ADS1115_CFG_MUX_LENGTH, mux)) {
+        if (!m_Staging && getMode() == ADS1115_MODE_CONTINUOUS) {
           // Force a stop/start
           setMode(ADS1115_MODE_SINGLESHOT);
           getConversion();
@@ -360,14 +495,14 @@ void ADS1115::setMultiplexer(uint8_t mux) {
     
 }
 /** Get programmable gain amplifier level.
+ * Served from the shadow CONFIG register, no I2C transfer.
  * @return Current programmable gain amplifier level
  * @see ADS1115_RA_CONFIG
  * @see ADS1115_CFG_PGA_BIT
  * @see ADS1115_CFG_PGA_LENGTH
  */
 uint8_t ADS1115::getGain() {
-    pgaMode = (uint8_t)readBitsW(ADS1115_RA_CONFIG, ADS1115_CFG_PGA_BIT, ADS1115_CFG_PGA_LENGTH);
-    return pgaMode;
+    return getConfigBits(ADS1115_CFG_PGA_BIT, ADS1115_CFG_PGA_LENGTH);
 }
 /** Set programmable gain amplifier level.  
  * Continous mode may fill the conversion register
@@ -385,9 +520,8 @@ uint8_t ADS1115::getGain() {
  * @see ADS1115_CFG_PGA_LENGTH
  */
 void ADS1115::setGain(uint8_t gain) {
-    if (writeBitsW(ADS1115_RA_CONFIG, ADS1115_CFG_PGA_BIT, ADS1115_CFG_PGA_LENGTH, gain)) {
-      pgaMode = gain;
-         if (devMode == ADS1115_MODE_CONTINUOUS) {
+    if (setConfigBits(ADS1115_CFG_PGA_BIT, ADS1115_CFG_PGA_LENGTH, gain)) {
+         if (!m_Staging && getMode() == ADS1115_MODE_CONTINUOUS) {
             // Force a stop/start
             setMode(ADS1115_MODE_SINGLESHOT);
             getConversion();
@@ -403,7 +537,7 @@ void ADS1115::setGain(uint8_t gain) {
  * @see ADS1115_CFG_MODE_BIT
  */
 uint8_t ADS1115::getMode() {
-    return ((readRegister(ADS1115_RA_CONFIG) & (1 << ADS1115_CFG_MODE_BIT)) ? ADS1115_MODE_SINGLESHOT : ADS1115_MODE_CONTINUOUS);
+    return getConfigBits(ADS1115_CFG_MODE_BIT, 1) ? ADS1115_MODE_SINGLESHOT : ADS1115_MODE_CONTINUOUS;
 }
 /** Set device mode.
  * @param mode New device mode
@@ -413,9 +547,7 @@ uint8_t ADS1115::getMode() {
  * @see ADS1115_CFG_MODE_BIT
  */
 void ADS1115::setMode(uint8_t mode) {
-    if (writeBitW(ADS1115_RA_CONFIG, ADS1115_CFG_MODE_BIT, mode)) {
-        devMode = mode;
-    }
+    setConfigBits(ADS1115_CFG_MODE_BIT, 1, mode);
 }
 /** Get data rate.
  * @return Current data rate
@@ -424,7 +556,7 @@ void ADS1115::setMode(uint8_t mode) {
  * @see ADS1115_CFG_DR_LENGTH
  */
 uint8_t ADS1115::getRate() {
-    return readBitsW(ADS1115_RA_CONFIG, ADS1115_CFG_DR_BIT, ADS1115_CFG_DR_LENGTH);
+    return getConfigBits(ADS1115_CFG_DR_BIT, ADS1115_CFG_DR_LENGTH);
 }
 /** Set data rate.
  * @param rate New data rate
@@ -441,7 +573,7 @@ uint8_t ADS1115::getRate() {
  * @see ADS1115_CFG_DR_LENGTH
  */
 void ADS1115::setRate(uint8_t rate) {
-    writeBitsW(ADS1115_RA_CONFIG, ADS1115_CFG_DR_BIT, ADS1115_CFG_DR_LENGTH, rate);
+    setConfigBits(ADS1115_CFG_DR_BIT, ADS1115_CFG_DR_LENGTH, rate);
 }
 /** Get comparator mode.
  * @return Current comparator mode
@@ -451,7 +583,7 @@ void ADS1115::setRate(uint8_t rate) {
  * @see ADS1115_CFG_COMP_MODE_BIT
  */
 uint8_t ADS1115::getComparatorMode() {
-  return ((readRegister(ADS1115_RA_CONFIG) & (1 << ADS1115_CFG_COMP_MODE_BIT)) ? ADS1115_COMP_MODE_WINDOW : ADS1115_COMP_MODE_HYSTERESIS);
+  return getConfigBits(ADS1115_CFG_COMP_MODE_BIT, 1) ? ADS1115_COMP_MODE_WINDOW : ADS1115_COMP_MODE_HYSTERESIS;
 }
 /** Set comparator mode.
  * @param mode New comparator mode
@@ -461,7 +593,7 @@ uint8_t ADS1115::getComparatorMode() {
  * @see ADS1115_CFG_COMP_MODE_BIT
  */
 void ADS1115::setComparatorMode(uint8_t mode) {
-    writeBitW(ADS1115_RA_CONFIG, ADS1115_CFG_COMP_MODE_BIT, mode);
+    setConfigBits(ADS1115_CFG_COMP_MODE_BIT, 1, mode);
 }
 /** Get comparator polarity setting.
  * @return Current comparator polarity setting
@@ -471,7 +603,7 @@ void ADS1115::setComparatorMode(uint8_t mode) {
  * @see ADS1115_CFG_COMP_POL_BIT
  */
 uint8_t ADS1115::getComparatorPolarity() {
-  return ((readRegister(ADS1115_RA_CONFIG) & (1 << ADS1115_CFG_COMP_POL_BIT)) ? ADS1115_COMP_POL_ACTIVE_HIGH : ADS1115_COMP_POL_ACTIVE_LOW);
+  return getConfigBits(ADS1115_CFG_COMP_POL_BIT, 1) ? ADS1115_COMP_POL_ACTIVE_HIGH : ADS1115_COMP_POL_ACTIVE_LOW;
 }
 /** Set comparator polarity setting.
  * @param polarity New comparator polarity setting
@@ -481,7 +613,7 @@ uint8_t ADS1115::getComparatorPolarity() {
  * @see ADS1115_CFG_COMP_POL_BIT
  */
 void ADS1115::setComparatorPolarity(uint8_t polarity) {
-    writeBitW(ADS1115_RA_CONFIG, ADS1115_CFG_COMP_POL_BIT, polarity);
+    setConfigBits(ADS1115_CFG_COMP_POL_BIT, 1, polarity);
 }
 /** Get comparator latch enabled value.
  * @return Current comparator latch enabled value
@@ -491,7 +623,7 @@ void ADS1115::setComparatorPolarity(uint8_t polarity) {
  * @see ADS1115_CFG_COMP_LAT_BIT
  */
 bool ADS1115::getComparatorLatchEnabled() {
-  return ((readRegister(ADS1115_RA_CONFIG) & (1 << ADS1115_CFG_COMP_LAT_BIT)) ? ADS1115_COMP_LAT_LATCHING : ADS1115_COMP_LAT_NON_LATCHING);
+  return getConfigBits(ADS1115_CFG_COMP_LAT_BIT, 1) ? ADS1115_COMP_LAT_LATCHING : ADS1115_COMP_LAT_NON_LATCHING;
 }
 /** Set comparator latch enabled value.
  * @param enabled New comparator latch enabled value
@@ -501,7 +633,7 @@ bool ADS1115::getComparatorLatchEnabled() {
  * @see ADS1115_CFG_COMP_LAT_BIT
  */
 void ADS1115::setComparatorLatchEnabled(bool enabled) {
-    writeBitW(ADS1115_RA_CONFIG, ADS1115_CFG_COMP_LAT_BIT, enabled);
+    setConfigBits(ADS1115_CFG_COMP_LAT_BIT, 1, enabled);
 }
 /** Get comparator queue mode.
  * @return Current comparator queue mode
@@ -514,7 +646,7 @@ void ADS1115::setComparatorLatchEnabled(bool enabled) {
  * @see ADS1115_CFG_COMP_QUE_LENGTH
  */
 uint8_t ADS1115::getComparatorQueueMode() {
-    return readBitsW(ADS1115_RA_CONFIG, ADS1115_CFG_COMP_QUE_BIT, ADS1115_CFG_COMP_QUE_LENGTH);
+    return getConfigBits(ADS1115_CFG_COMP_QUE_BIT, ADS1115_CFG_COMP_QUE_LENGTH);
 }
 /** Set comparator queue mode.
  * @param mode New comparator queue mode
@@ -527,7 +659,7 @@ uint8_t ADS1115::getComparatorQueueMode() {
  * @see ADS1115_CFG_COMP_QUE_LENGTH
  */
 void ADS1115::setComparatorQueueMode(uint8_t mode) {
-    writeBitsW(ADS1115_RA_CONFIG, ADS1115_CFG_COMP_QUE_BIT, ADS1115_CFG_COMP_QUE_LENGTH, mode);
+    setConfigBits(ADS1115_CFG_COMP_QUE_BIT, ADS1115_CFG_COMP_QUE_LENGTH, mode);
 }
 
 // *_THRESH registers
@@ -624,39 +756,23 @@ void ADS1115::showConfigRegister()
 };
 
 
-bool ADS1115::writeBitW(uint8_t regAddr, uint8_t bitNum, uint16_t data)
+bool ADS1115::setConfigBits(uint8_t bitStart, uint8_t length, uint16_t data)
 {
-  uint16_t val = readRegister(regAddr);
-    if(data) {
-        val |= (1 << bitNum);
-    } else {
-        val &= ~(1 << bitNum);
-    }
-    return (writeRegister(regAddr, val) >= 0);
-}
-
-bool ADS1115::writeBitsW(uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t data)
-{
-  int ret = readRegister(regAddr);
-    if(ret < 0) {
-        return false;
-    }
-    uint16_t val = ret & 0xffff;
     uint16_t mask = ((1 << length) - 1) << (bitStart - length + 1);
     data <<= (bitStart - length + 1); // shift data into correct position
     data &= mask; // zero all non-important bits in data
-    val &= ~(mask); // zero all important bits in existing word
-    val |= data; // combine data with existing word
-    return (writeRegister(regAddr, val) >= 0);
+    m_Config &= ~(mask); // zero all important bits in the shadow register
+    m_Config |= data; // combine data with the shadow register
+    if (m_Staging) {
+        return true;
+    }
+    return commitConfig();
 }
 
-uint16_t ADS1115::readBitsW(uint8_t regAddr, uint8_t bitStart, uint8_t length)
+uint16_t ADS1115::getConfigBits(uint8_t bitStart, uint8_t length)
 {
-  uint16_t val = readRegister(ADS1115_RA_CONFIG);
     uint16_t mask = ((1 << length) - 1) << (bitStart - length + 1);
-    val &= mask;
-    val >>= (bitStart - length + 1);
-    return val;
+    return (m_Config & mask) >> (bitStart - length + 1);
 }
 
 bool ADS1115::writeRegister(uint8_t regAddr, uint16_t data)
@@ -664,11 +780,13 @@ bool ADS1115::writeRegister(uint8_t regAddr, uint16_t data)
   uint8_t buf[2];
   buf[1] = (data & 0xFF);
   buf[0] = ((data >> 8) & 0xFF);
+  TraceScope trace(TRACE_I2C_WRITE, m_Address);
   return (wiringPiI2CWriteBlockData(m_Fd, regAddr, 2, buf) > 0);
 }
 
 uint16_t ADS1115::readRegister(uint8_t regAddr)
 {
+  TraceScope trace(TRACE_I2C_READ, m_Address);
   uint8_t buf[2];
   wiringPiI2CReadBlockData(m_Fd, regAddr, 2, buf);
   uint16_t data = ((buf[0] << 8) | buf[1]);
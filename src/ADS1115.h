@@ -38,6 +38,7 @@ THE SOFTWARE.
 #define _ADS1115_H_
 
 #include <stdint.h>
+#include <time.h>
 
 // -----------------------------------------------------------------------------
 // Arduino-style "Serial.print" debug constant (uncomment to enable)
@@ -68,6 +69,9 @@ THE SOFTWARE.
 #define ADS1115_CFG_COMP_LAT_BIT    2
 #define ADS1115_CFG_COMP_QUE_BIT    1
 #define ADS1115_CFG_COMP_QUE_LENGTH 2
+#define ADS1115_CFG_DEFAULT         0x8583 // power-on reset value
+// The shadow CONFIG starts without the OS bit, with it every commit would start a conversion
+#define ADS1115_CFG_SHADOW_DEFAULT  (ADS1115_CFG_DEFAULT & ~(1 << ADS1115_CFG_OS_BIT))
 
 #define ADS1115_OS_INACTIVE         0x00
 #define ADS1115_OS_ACTIVE           0x01
@@ -125,6 +129,9 @@ THE SOFTWARE.
 #define ADS1115_COMP_QUE_ASSERT4    0x02
 #define ADS1115_COMP_QUE_DISABLE    0x03 // default
 
+// ALERT/RDY pins must be GPIOs below this number
+#define ADS1115_MAX_ALERT_PIN       64
+
 // -----------------------------------------------------------------------------
 // Arduino-style "Serial.print" debug constant (uncomment to enable)
 // -----------------------------------------------------------------------------
@@ -139,8 +146,18 @@ class ADS1115 {
         void initialize();
         bool testConnection();
 
+        // Coalesced CONFIG writes
+        void beginConfig();
+        bool commitConfig();
+
         // SINGLE SHOT utilities
         void waitBusy(uint16_t max_retries);
+        bool conversionReady();
+
+        // ALERT/RDY conversion-ready interrupt
+        bool enableConversionReadyPin(int pin);
+        int getConversionReadyPin();
+        struct timespec getConversionTime();
 
         // Read the current CONVERSION register
         int16_t getConversion();
@@ -160,6 +177,7 @@ class ADS1115 {
         // Utility
         float getMilliVolts();
         float getMvPerCount();
+        static float getMvPerCount(uint8_t gain);
 
         // CONFIG register
         uint8_t getOpStatus();
@@ -190,15 +208,21 @@ class ADS1115 {
         // DEBUG
         void showConfigRegister();
 
+        // Called from the GPIO edge handler
+        void handleConversionReady();
+
     private:
         int m_Fd;
-        uint8_t devMode;
-        uint8_t muxMode;
-        uint8_t pgaMode;
-        bool writeBitW(uint8_t regAddr, uint8_t bitNum, uint16_t data);
-        bool writeBitsW(uint8_t regAddr, uint8_t bitStart, uint8_t length, uint16_t data);
+        uint8_t m_Address;
+        uint16_t m_Config; // shadow copy of the CONFIG register
+        bool m_Staging;
+        int m_AlertPin;
+        uint32_t m_ReadyCount; // bumped by the edge handler
+        uint32_t m_StartCount; // m_ReadyCount when the last conversion was triggered
+        uint64_t m_ReadyTime; // CLOCK_MONOTONIC ns of the last edge
+        bool setConfigBits(uint8_t bitStart, uint8_t length, uint16_t data);
+        uint16_t getConfigBits(uint8_t bitStart, uint8_t length);
 	bool writeRegister(uint8_t regAddr, uint16_t data);
-        uint16_t readBitsW(uint8_t regAddr, uint8_t bitStart, uint8_t length);
 	uint16_t readRegister(uint8_t regAddr);
 };
 
@@ -0,0 +1,134 @@
+#include "ADS1115Scanner.h"
+
+#include <unistd.h>
+
+/* Nominal samples per second for ADS1115_RATE_8 .. ADS1115_RATE_860 */
+static const int s_SamplesPerSecond[] = { 8, 16, 32, 64, 128, 250, 475, 860 };
+
+ADS1115Scanner::ADS1115Scanner(boost::shared_ptr<ADS1115> adc, uint8_t rate) :
+  m_Adc(adc),
+  m_Rate(rate & 0x07),
+  m_Running(false)
+{
+  pthread_mutex_init(&m_Mutex, NULL);
+}
+
+ADS1115Scanner::~ADS1115Scanner()
+{
+  stop();
+  pthread_mutex_destroy(&m_Mutex);
+}
+
+int ADS1115Scanner::addChannel(uint8_t mux, uint8_t gain)
+{
+  for(size_t i = 0; i < m_Channels.size(); ++i) {
+    if(m_Channels[i].mux == mux) {
+      return i;
+    }
+  }
+  Channel channel;
+  channel.mux = mux;
+  channel.gain = gain;
+  channel.sample.raw = 0;
+  channel.sample.millivolts = 0;
+  channel.sample.time.tv_sec = 0;
+  channel.sample.time.tv_nsec = 0;
+  channel.sample.sequence = 0;
+  m_Channels.push_back(channel);
+  return m_Channels.size() - 1;
+}
+
+bool ADS1115Scanner::start()
+{
+  if(m_Running || m_Channels.empty()) {
+    return false;
+  }
+  m_Running = true;
+  if(pthread_create(&m_Thread, NULL, &ADS1115Scanner::threadMain, this) != 0) {
+    m_Running = false;
+    return false;
+  }
+  return true;
+}
+
+void ADS1115Scanner::stop()
+{
+  if(m_Running) {
+    m_Running = false;
+    pthread_join(m_Thread, NULL);
+  }
+}
+
+ADS1115Scanner::Sample ADS1115Scanner::getSample(int channel)
+{
+  pthread_mutex_lock(&m_Mutex);
+  Sample sample = m_Channels.at(channel).sample;
+  pthread_mutex_unlock(&m_Mutex);
+  return sample;
+}
+
+int ADS1115Scanner::rateFromSamplesPerSecond(int sps)
+{
+  for(int rate = ADS1115_RATE_8; rate <= ADS1115_RATE_860; ++rate) {
+    if(s_SamplesPerSecond[rate] == sps) {
+      return rate;
+    }
+  }
+  return -1;
+}
+
+void* ADS1115Scanner::threadMain(void* arg)
+{
+  static_cast<ADS1115Scanner*>(arg)->scan();
+  return NULL;
+}
+
+void ADS1115Scanner::scan()
+{
+  size_t index = 0;
+  while(m_Running) {
+    Sample sample;
+    if(convert(m_Channels[index], sample)) {
+      pthread_mutex_lock(&m_Mutex);
+      sample.sequence = m_Channels[index].sample.sequence + 1;
+      m_Channels[index].sample = sample;
+      pthread_mutex_unlock(&m_Mutex);
+    }
+    if(++index == m_Channels.size()) {
+      index = 0;
+    }
+  }
+}
+
+/* Single-shot conversion of one channel: one CONFIG write to trigger, sleep for
+   the nominal conversion time, then wait for completion and read the result. */
+bool ADS1115Scanner::convert(Channel& channel, Sample& sample)
+{
+  m_Adc->beginConfig();
+  m_Adc->setMultiplexer(channel.mux);
+  m_Adc->setGain(channel.gain);
+  m_Adc->setMode(ADS1115_MODE_SINGLESHOT);
+  m_Adc->setRate(m_Rate);
+  m_Adc->setOpStatus(ADS1115_OS_ACTIVE);
+  m_Adc->commitConfig();
+
+  struct timespec wait = { 0, 1000000000 / s_SamplesPerSecond[m_Rate] };
+  nanosleep(&wait, NULL);
+
+  /* Conversions run up to 10% slow, give up well after that */
+  for(int retries = 0; !m_Adc->conversionReady(); ++retries) {
+    if(!m_Running || retries > 100) {
+      return false;
+    }
+    usleep(1000000 / s_SamplesPerSecond[m_Rate] / 50 + 1);
+  }
+
+  if(m_Adc->getConversionReadyPin() >= 0) {
+    sample.time = m_Adc->getConversionTime();
+  } else {
+    clock_gettime(CLOCK_MONOTONIC, &sample.time);
+  }
+  sample.raw = m_Adc->getConversion();
+  sample.millivolts = sample.raw * m_Adc->getMvPerCount();
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef ADS1115_SCANNER_H
+#define ADS1115_SCANNER_H
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <vector>
+#include "ADS1115.h"
+
+#include <boost/shared_ptr.hpp>
+
+/* Walks the configured channels of one ADS1115 back-to-back in a background
+   thread and publishes the latest reading of every channel. */
+class ADS1115Scanner
+{
+ public:
+  struct Sample
+  {
+    int16_t raw;
+    float millivolts;
+    struct timespec time;
+    uint32_t sequence;
+  };
+
+  ADS1115Scanner(boost::shared_ptr<ADS1115> adc, uint8_t rate);
+  ~ADS1115Scanner();
+
+  int addChannel(uint8_t mux, uint8_t gain);
+  bool start();
+  void stop();
+
+  Sample getSample(int channel);
+
+  static int rateFromSamplesPerSecond(int sps);
+
+ private:
+  struct Channel
+  {
+    uint8_t mux;
+    uint8_t gain;
+    Sample sample;
+  };
+
+  static void* threadMain(void* arg);
+  void scan();
+  bool convert(Channel& channel, Sample& sample);
+
+  boost::shared_ptr<ADS1115> m_Adc;
+  uint8_t m_Rate;
+  std::vector<Channel> m_Channels;
+  pthread_t m_Thread;
+  pthread_mutex_t m_Mutex;
+  volatile bool m_Running;
+};
+#endif
@@ -0,0 +1,133 @@
+#include "Actuator.h"
+#include "Timing.h"
+#include "Trace.h"
+#include <algorithm>
+
+Actuator::Actuator(boost::shared_ptr<Motor> motor, boost::shared_ptr<Servo> steering,
+                   const std::vector<boost::shared_ptr<Adafruit_PWMServoDriver> >& drivers, int frequency) :
+  m_Motor(motor),
+  m_Steering(steering),
+  m_Drivers(drivers),
+  m_Period(NSEC_PER_SEC / ((frequency > 0) ? frequency : 1)),
+  m_SteeringStep(0),
+  m_ThrottleStep(0),
+  m_Running(false)
+{
+  m_Target.speed = 0;
+  m_Target.direction = 0;
+  m_PublishedTarget.write(m_Target);
+}
+
+Actuator::~Actuator()
+{
+  stop();
+}
+
+/* Slew rates are turned into the largest change per update */
+void Actuator::setSteeringSlew(int slew)
+{
+  m_SteeringStep = (slew > 0) ? std::max<int>(1, slew * m_Period / NSEC_PER_SEC) : 0;
+}
+
+void Actuator::setThrottleSlew(int slew)
+{
+  m_ThrottleStep = (slew > 0) ? std::max<int>(1, slew * m_Period / NSEC_PER_SEC) : 0;
+}
+
+bool Actuator::start()
+{
+  if(m_Running) {
+    return false;
+  }
+  m_Running = true;
+  if(pthread_create(&m_Thread, NULL, &Actuator::threadMain, this) != 0) {
+    m_Running = false;
+    return false;
+  }
+  return true;
+}
+
+void Actuator::stop()
+{
+  if(m_Running) {
+    m_Running = false;
+    pthread_join(m_Thread, NULL);
+  }
+}
+
+void Actuator::setSpeed(int speed)
+{
+  m_Target.speed = speed;
+  m_PublishedTarget.write(m_Target);
+}
+
+void Actuator::setDirection(int direction)
+{
+  m_Target.direction = direction;
+  m_PublishedTarget.write(m_Target);
+}
+
+/* Step from current toward target by at most maxStep, 0 means no limit */
+int Actuator::slew(int current, int target, int maxStep)
+{
+  if(maxStep <= 0) {
+    return target;
+  }
+  return std::max(current - maxStep, std::min(current + maxStep, target));
+}
+
+void* Actuator::threadMain(void* arg)
+{
+  static_cast<Actuator*>(arg)->actuate();
+  return NULL;
+}
+
+void Actuator::actuate()
+{
+  Target target = m_PublishedTarget.read();
+  int speed = target.speed;
+  int direction = target.direction;
+  m_Motor->setSpeed(speed);
+  m_Steering->setDirection(direction);
+  uint64_t deadline = monotonicNs();
+
+  while(m_Running) {
+    TraceScope trace(TRACE_ACTUATE);
+    target = m_PublishedTarget.read();
+    int nextSpeed;
+    if((speed > 0 && target.speed < speed) || (speed < 0 && target.speed > speed)) {
+      /* Slowing down is never delayed, but a change of direction stops at 0 first */
+      nextSpeed = ((speed > 0) != (target.speed > 0) && target.speed != 0) ? 0 : target.speed;
+    } else {
+      nextSpeed = slew(speed, target.speed, m_ThrottleStep);
+    }
+    int nextDirection = slew(direction, target.direction, m_SteeringStep);
+
+    for(size_t i = 0; i < m_Drivers.size(); ++i) {
+      m_Drivers[i]->beginBatch();
+    }
+    if(nextSpeed != speed) {
+      TraceScope motorTrace(TRACE_MOTOR);
+      m_Motor->setSpeed(nextSpeed);
+      speed = nextSpeed;
+    }
+    m_Motor->update(monotonicNs());
+    if(nextDirection != direction) {
+      TraceScope steeringTrace(TRACE_STEERING);
+      m_Steering->setDirection(nextDirection);
+      direction = nextDirection;
+    }
+    for(size_t i = 0; i < m_Drivers.size(); ++i) {
+      m_Drivers[i]->commit();
+    }
+    trace.stop();
+
+    /* Fixed rate, but never try to catch up on missed slots */
+    deadline += m_Period;
+    uint64_t now = monotonicNs();
+    if(deadline < now) {
+      deadline = now;
+    }
+    sleepUntilNs(deadline);
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef ACTUATOR_H
+#define ACTUATOR_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+#include "Motor.h"
+#include "Servo.h"
+#include "Adafruit_PWMServoDriver.h"
+#include "SeqLock.h"
+
+#include <boost/shared_ptr.hpp>
+
+/* Moves steering and throttle toward the targets set by the control
+   loop in a thread of its own, at most by the slew rate per second.
+   While it runs it is the only writer of the PWM drivers. The servos
+   take a new pulse once per PWM period, so updating at the PWM
+   frequency is enough. */
+class Actuator
+{
+ public:
+  Actuator(boost::shared_ptr<Motor> motor, boost::shared_ptr<Servo> steering,
+           const std::vector<boost::shared_ptr<Adafruit_PWMServoDriver> >& drivers, int frequency);
+  ~Actuator();
+
+  /* Units per second, 0 moves in a single step */
+  void setSteeringSlew(int slew);
+  void setThrottleSlew(int slew);
+
+  bool start();
+  void stop();
+
+  /* Only to be called from one thread */
+  void setSpeed(int speed);
+  void setDirection(int direction);
+
+  static int slew(int current, int target, int maxStep);
+
+ private:
+  struct Target
+  {
+    int speed;
+    int direction;
+  };
+
+  static void* threadMain(void* arg);
+  void actuate();
+
+  boost::shared_ptr<Motor> m_Motor;
+  boost::shared_ptr<Servo> m_Steering;
+  std::vector<boost::shared_ptr<Adafruit_PWMServoDriver> > m_Drivers;
+  uint64_t m_Period;
+  int m_SteeringStep;
+  int m_ThrottleStep;
+  Target m_Target;
+  SeqLock<Target> m_PublishedTarget;
+
+  pthread_t m_Thread;
+  volatile bool m_Running;
+};
+#endif
@@ -17,6 +17,7 @@
 
 #include "Adafruit_PWMServoDriver.h"
 #include <wiringPiI2C.h>
+#include "Trace.h"
 #include <iostream>
 #include <unistd.h>
 #include <cmath>
@@ -24,26 +25,39 @@
 // Set to true to print some debug messages, or false to disable them.
 #define ENABLE_DEBUG_OUTPUT true
 
-Adafruit_PWMServoDriver::Adafruit_PWMServoDriver(uint8_t addr)
+Adafruit_PWMServoDriver::Adafruit_PWMServoDriver(uint8_t addr) :
+  m_Address(addr),
+  m_Frequency(0),
+  m_Batch(false),
+  m_Dirty(0),
+  m_Committed(0)
 {
   m_Fd = wiringPiI2CSetup(addr/2);
 
+  for(int i = 0; i < PCA9685_CHANNELS; ++i) {
+    m_On[i] = 0;
+    m_Off[i] = 0;
+    m_CommittedOn[i] = 0;
+    m_CommittedOff[i] = 0;
+  }
+
   write8(PCA9685_MODE2, PCA9685_BIT_OUTDRV);
-  write8(PCA9685_MODE1, PCA9685_BIT_ALLCALL);
+  write8(PCA9685_MODE1, PCA9685_BIT_ALLCALL | PCA9685_BIT_AI);
   usleep(5);
 
   uint8_t mode1 = read8(PCA9685_MODE1);
-  write8(PCA9685_MODE1, mode1);
+  write8(PCA9685_MODE1, mode1 | PCA9685_BIT_AI);
   usleep(5);
 }
 
 void Adafruit_PWMServoDriver::reset(void)
 {
- write8(PCA9685_MODE1, 0x0);
+ write8(PCA9685_MODE1, PCA9685_BIT_AI);
 }
 
 void Adafruit_PWMServoDriver::setPWMFreq(float freq)
 {
+  m_Frequency = freq;
   freq *= 0.9;  // Correct for overshoot in the frequency setting (see issue #11).
   float prescaleval = 25000000;
   prescaleval /= 4096;
@@ -63,19 +77,65 @@ void Adafruit_PWMServoDriver::setPWMFreq(float freq)
   write8(PCA9685_PRESCALE, prescale); // set the prescaler
   write8(PCA9685_MODE1, oldmode);
   usleep(5);
-  write8(PCA9685_MODE1, oldmode | PCA9685_BIT_RESTART);  //  This sets the MODE1 register to turn on auto increment.
+  write8(PCA9685_MODE1, oldmode | PCA9685_BIT_RESTART | PCA9685_BIT_AI);  //  This sets the MODE1 register to turn on auto increment.
                                           // This is why the beginTransmission below was not working.
   //  Serial.print("Mode now 0x"); Serial.println(read8(PCA9685_MODE1), HEX);
 }
 
+// Frequency last requested with setPWMFreq(), 0 before that
+float Adafruit_PWMServoDriver::getPWMFreq()
+{
+  return m_Frequency;
+}
+
 void Adafruit_PWMServoDriver::setPWM(uint8_t num, uint16_t on, uint16_t off)
 {
   //Serial.print("Setting PWM "); Serial.print(num); Serial.print(": "); Serial.print(on); Serial.print("->"); Serial.println(off);
 
-  write8(LED0_ON_L+4*num, on & 0xFF);
-  write8(LED0_ON_H+4*num, on >> 8);
-  write8(LED0_OFF_L+4*num, off & 0xFF);
-  write8(LED0_OFF_H+4*num, off >> 8);
+  if(num >= PCA9685_CHANNELS) {
+    return;
+  }
+  m_On[num] = on;
+  m_Off[num] = off;
+  if((m_Committed & (1 << num)) && m_CommittedOn[num] == on && m_CommittedOff[num] == off) {
+    // Nothing changes, also drops a staged value that went back to the old one
+    m_Dirty &= ~(1 << num);
+    return;
+  }
+  m_Dirty |= (1 << num);
+  if(!m_Batch) {
+    flush();
+  }
+}
+
+void Adafruit_PWMServoDriver::beginBatch()
+{
+  m_Batch = true;
+}
+
+// Sends every staged channel. Runs of adjacent channels share one auto-increment
+// block write, so steering and throttle on neighbouring channels cost a single transaction.
+void Adafruit_PWMServoDriver::flush()
+{
+  uint8_t num = 0;
+  while(m_Dirty) {
+    while(!(m_Dirty & (1 << num))) {
+      ++num;
+    }
+    uint8_t count = 0;
+    while(num + count < PCA9685_CHANNELS && (m_Dirty & (1 << (num + count))) && count < PCA9685_MAX_BLOCK/4) {
+      m_Dirty &= ~(1 << (num + count));
+      ++count;
+    }
+    writeChannels(num, count);
+    num += count;
+  }
+}
+
+void Adafruit_PWMServoDriver::commit()
+{
+  flush();
+  m_Batch = false;
 }
 
 // Sets pin without having to deal with on/off tick placement and properly handles
@@ -115,10 +175,56 @@ void Adafruit_PWMServoDriver::setPin(uint8_t num, uint16_t val, bool invert)
 
 uint8_t Adafruit_PWMServoDriver::read8(uint8_t addr)
 {
+  TraceScope trace(TRACE_I2C_READ, m_Address);
   return wiringPiI2CReadReg8(m_Fd, addr);
 }
 
 void Adafruit_PWMServoDriver::write8(uint8_t addr, uint8_t d)
 {
+  TraceScope trace(TRACE_I2C_WRITE, m_Address);
   wiringPiI2CWriteReg8(m_Fd, addr, d);
 }
+
+// Unknown before the first write and after a failed one, the channel is resent then
+int Adafruit_PWMServoDriver::getCommittedPin(uint8_t num)
+{
+  if(num >= PCA9685_CHANNELS || !(m_Committed & (1 << num))) {
+    return -1;
+  }
+  if(m_CommittedOn[num] == 4096) {
+    return 4095;
+  }
+  if(m_CommittedOff[num] == 4096) {
+    return 0;
+  }
+  return m_CommittedOff[num];
+}
+
+// When the ON count of the first channel stays the same, which it does for servos
+// where it is always 0, the block starts at its OFF_L register.
+void Adafruit_PWMServoDriver::writeChannels(uint8_t first, uint8_t count)
+{
+  uint8_t buf[PCA9685_MAX_BLOCK];
+  for(uint8_t i = 0; i < count; ++i) {
+    buf[4*i] = m_On[first+i] & 0xFF;
+    buf[4*i+1] = m_On[first+i] >> 8;
+    buf[4*i+2] = m_Off[first+i] & 0xFF;
+    buf[4*i+3] = m_Off[first+i] >> 8;
+  }
+  uint8_t skip = 0;
+  if((m_Committed & (1 << first)) && m_CommittedOn[first] == m_On[first]) {
+    skip = 2;
+  }
+  TraceScope trace(TRACE_I2C_WRITE, m_Address);
+  uint16_t mask = ((1 << count) - 1) << first;
+  if(wiringPiI2CWriteBlockData(m_Fd, LED0_ON_L+4*first+skip, 4*count-skip, buf+skip) == -1) {
+    // The chip may have taken part of it, send everything next time
+    m_Committed &= ~mask;
+    return;
+  }
+  for(uint8_t i = first; i < first + count; ++i) {
+    m_CommittedOn[i] = m_On[i];
+    m_CommittedOff[i] = m_Off[i];
+  }
+  m_Committed |= mask;
+}
@@ -39,25 +39,51 @@
 #define ALLLED_OFF_H 0xFD
 
 #define PCA9685_BIT_RESTART 0x80
+#define PCA9685_BIT_AI      0x20
 #define PCA9685_BIT_SLEEP   0x10
 #define PCA9685_BIT_ALLCALL 0x01
 #define PCA9685_BIT_INVRT   0x10
 #define PCA9685_BIT_OUTDRV  0x04
 
+#define PCA9685_CHANNELS    16
+// Largest SMBus block transfer, i.e. eight channels of LEDn_ON_L..LEDn_OFF_H
+#define PCA9685_MAX_BLOCK   32
+
 
 class Adafruit_PWMServoDriver {
  public:
   Adafruit_PWMServoDriver(uint8_t addr);
   void reset(void);
   void setPWMFreq(float freq);
+  float getPWMFreq();
   void setPWM(uint8_t num, uint16_t on, uint16_t off);
   void setPin(uint8_t num, uint16_t val, bool invert=false);
+  // Non-inverted setPin() value the chip holds, -1 if unknown
+  int getCommittedPin(uint8_t num);
+
+  // While a batch is open setPWM()/setPin() only stage channel values.
+  // flush() sends the staged channels, commit() flushes and closes the batch.
+  // Values the chip already holds are not sent again.
+  void beginBatch();
+  void flush();
+  void commit();
 
  private:
   int m_Fd;
+  uint8_t m_Address;
+  float m_Frequency;
+  bool m_Batch;
+  uint16_t m_Dirty;
+  uint16_t m_On[PCA9685_CHANNELS];
+  uint16_t m_Off[PCA9685_CHANNELS];
+  // What the chip holds, valid for the channels set in m_Committed
+  uint16_t m_Committed;
+  uint16_t m_CommittedOn[PCA9685_CHANNELS];
+  uint16_t m_CommittedOff[PCA9685_CHANNELS];
 
   uint8_t read8(uint8_t addr);
   void write8(uint8_t addr, uint8_t d);
+  void writeChannels(uint8_t first, uint8_t count);
 };
 
 #endif
@@ -1,8 +1,11 @@
 #include "AnalogDistanceSensor.h"
+#include <algorithm>
 
 
-AnalogDistanceSensor::AnalogDistanceSensor(boost::shared_ptr<ADS1115> adc, uint8_t channel) : m_Adc(adc), m_Channel(channel)
+AnalogDistanceSensor::AnalogDistanceSensor(boost::shared_ptr<ADS1115> adc, uint8_t channel) : m_Adc(adc), m_Channel(channel), m_ScanChannel(-1), m_ScanSequence(0)
 {
+  m_SampleTime.tv_sec = 0;
+  m_SampleTime.tv_nsec = 0;
   switch(channel) {
   case 0:
     m_Channel = ADS1115_MUX_P0_NG;
@@ -23,29 +26,125 @@ AnalogDistanceSensor::~AnalogDistanceSensor()
 {
 }
 
+/* Take readings from a scanner running on the ADC instead of triggering conversions */
+void AnalogDistanceSensor::attachScanner(boost::shared_ptr<ADS1115Scanner> scanner)
+{
+  m_Scanner = scanner;
+  m_ScanChannel = scanner->addChannel(m_Channel, getGain());
+}
+
+bool AnalogDistanceSensor::isScanned()
+{
+  return m_Scanner.get() != NULL;
+}
 
 bool AnalogDistanceSensor::initiateRanging()
 {
+  if(m_Scanner) {
+    return true;
+  }
+  /* Mux, mode, gain and the conversion trigger go out in one CONFIG write */
+  m_Adc->beginConfig();
   m_Adc->setMultiplexer(m_Channel);
   m_Adc->setMode(ADS1115_MODE_SINGLESHOT);
-  setupRanging();
+  m_Adc->setGain(getGain());
   m_Adc->setOpStatus(ADS1115_OS_ACTIVE);
+  m_Adc->commitConfig();
   return true;
 }
 
 
 bool AnalogDistanceSensor::rangingComplete()
 {
+  if(m_Scanner) {
+    return m_Scanner->getSample(m_ScanChannel).sequence != m_ScanSequence;
+  }
+  /* The multiplexer comes from the shadow CONFIG, only the OS poll hits the bus
+     and not even that when the ALERT/RDY pin is wired up */
   if(m_Adc->getMultiplexer() != m_Channel) {
     return false;
   }
-  return (m_Adc->getOpStatus()==ADS1115_OS_INACTIVE);
+  return m_Adc->conversionReady();
 }
 
 uint16_t AnalogDistanceSensor::getRange()
 {
+  if(m_Scanner) {
+    ADS1115Scanner::Sample sample = m_Scanner->getSample(m_ScanChannel);
+    m_ScanSequence = sample.sequence;
+    m_SampleTime = sample.time;
+    return countsToRange(sample.raw);
+  }
   if(m_Adc->getMultiplexer() != m_Channel) {
     return 0;
   }
-  return voltageToRange(m_Adc->getMilliVolts());
+  if(m_Adc->getConversionReadyPin() >= 0) {
+    m_SampleTime = m_Adc->getConversionTime();
+  } else {
+    clock_gettime(CLOCK_MONOTONIC, &m_SampleTime);
+  }
+  return countsToRange(m_Adc->getConversion());
+}
+
+/* When the value returned by the last getRange() was converted */
+struct timespec AnalogDistanceSensor::getSampleTime()
+{
+  return m_SampleTime;
+}
+
+static bool compareMilliVolts(const AnalogDistanceSensor::CalibrationPoint& a, const AnalogDistanceSensor::CalibrationPoint& b)
+{
+  return a.millivolts < b.millivolts;
+}
+
+/* Replace the driver's generic curve by straight lines between measured
+   points. Takes effect with the next buildTable(). */
+void AnalogDistanceSensor::setCalibration(const std::vector<CalibrationPoint>& points)
+{
+  m_Calibration = points;
+  std::sort(m_Calibration.begin(), m_Calibration.end(), compareMilliVolts);
+  m_Table.clear();
+}
+
+/* Precompute the range for every table entry at the sensor's gain, so a
+   reading costs one lookup instead of the curve evaluation */
+void AnalogDistanceSensor::buildTable()
+{
+  float mvPerCount = ADS1115::getMvPerCount(getGain());
+  m_Table.resize(ANALOG_TABLE_SIZE);
+  for(int i = 0; i < ANALOG_TABLE_SIZE; ++i) {
+    /* Middle of the counts covered by the entry */
+    float millivolts = ((i << ANALOG_TABLE_SHIFT) + (1 << ANALOG_TABLE_SHIFT) / 2) * mvPerCount;
+    float range = m_Calibration.empty() ? voltageToRange(millivolts) : calibratedRange(millivolts);
+    if(!(range < 65535)) {
+      range = 65535;
+    } else if(range < 0) {
+      range = 0;
+    }
+    m_Table[i] = (uint16_t)(range + 0.5f);
+  }
+}
+
+uint16_t AnalogDistanceSensor::countsToRange(int16_t raw)
+{
+  if(m_Table.empty()) {
+    buildTable();
+  }
+  return m_Table[(raw < 0) ? 0 : (raw >> ANALOG_TABLE_SHIFT)];
+}
+
+float AnalogDistanceSensor::calibratedRange(float millivolts)
+{
+  if(millivolts <= m_Calibration.front().millivolts) {
+    return m_Calibration.front().range;
+  }
+  for(size_t i = 1; i < m_Calibration.size(); ++i) {
+    const CalibrationPoint& low = m_Calibration[i - 1];
+    const CalibrationPoint& high = m_Calibration[i];
+    if(millivolts <= high.millivolts) {
+      float fraction = (millivolts - low.millivolts) / (high.millivolts - low.millivolts);
+      return low.range + fraction * ((float)high.range - low.range);
+    }
+  }
+  return m_Calibration.back().range;
 }
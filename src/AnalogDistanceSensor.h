@@ -2,29 +2,58 @@
 #define ANALOG_DISTANCE_SENSOR_H
 
 #include <stdint.h>
+#include <time.h>
+#include <vector>
 #include "ADS1115.h"
+#include "ADS1115Scanner.h"
 
 #include <boost/shared_ptr.hpp>
 
+/* Raw conversions are looked up in a table with one entry per 2^shift
+   counts, 4096 entries over the positive range of the ADC */
+#define ANALOG_TABLE_SHIFT 3
+#define ANALOG_TABLE_SIZE (32768 >> ANALOG_TABLE_SHIFT)
+
 class AnalogDistanceSensor
 {
  public:
+  struct CalibrationPoint
+  {
+    float millivolts;
+    uint16_t range;
+  };
+
   AnalogDistanceSensor(boost::shared_ptr<ADS1115> adc, uint8_t channel);
   virtual ~AnalogDistanceSensor();
 
+  void attachScanner(boost::shared_ptr<ADS1115Scanner> scanner);
+  bool isScanned();
+
+  void setCalibration(const std::vector<CalibrationPoint>& points);
+  void buildTable();
+
   bool initiateRanging();
   bool rangingComplete();
 
   uint16_t getRange();
+  struct timespec getSampleTime();
 
 private:
-  virtual void setupRanging() = 0;
-  virtual uint16_t voltageToRange(float millivolts) = 0;
+  virtual uint8_t getGain() = 0;
+  virtual float voltageToRange(float millivolts) = 0;
+  uint16_t countsToRange(int16_t raw);
+  float calibratedRange(float millivolts);
 
 protected:
   boost::shared_ptr<ADS1115> m_Adc;
 
  private:
   int m_Channel;
+  boost::shared_ptr<ADS1115Scanner> m_Scanner;
+  int m_ScanChannel;
+  uint32_t m_ScanSequence;
+  struct timespec m_SampleTime;
+  std::vector<CalibrationPoint> m_Calibration;
+  std::vector<uint16_t> m_Table;
 };
 #endif
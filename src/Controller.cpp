@@ -0,0 +1,153 @@
+#include "Controller.h"
+#include "Timing.h"
+
+#include <stdlib.h>
+#include <algorithm>
+
+Controller::Controller(int initialForwardSpeed, int initialReverseSpeed) :
+  m_InitialForwardSpeed(initialForwardSpeed),
+  m_InitialReverseSpeed(initialReverseSpeed)
+{
+  reset();
+}
+
+void Controller::reset()
+{
+  m_LastForward = false;
+  m_LastDirection = 0;
+  m_ForwardSpeed = m_InitialForwardSpeed;
+  m_ReverseSpeed = m_InitialReverseSpeed;
+  m_MaxForwardSpeed = m_InitialForwardSpeed;
+  m_MaxReverseSpeed = m_InitialReverseSpeed;
+  m_QuickRampup = false;
+  m_Moving = 0;
+  m_LastSpeedChange = 0;
+}
+
+/* One control cycle. Does no I/O, everything it looks at is in input
+   and the controller's own state. */
+Controller::Output Controller::update(const Input& input)
+{
+  Output output;
+  int reasons = 0;
+  bool forward = true;
+  int turnMultiplier = 1;
+  if(input.haveFront) {
+    if(input.front < 80) {
+      turnMultiplier = 2;
+      reasons |= REASON_FRONT_NEAR;
+    }
+    if(input.front < 50) {
+      turnMultiplier = 4;
+      reasons |= REASON_FRONT_CLOSE;
+    }
+    if(input.front < 30 || (!m_LastForward && input.front < 50)) {
+      turnMultiplier = -2;
+      forward = false;
+      reasons |= REASON_FRONT_BLOCKED;
+    }
+  }
+
+  int direction = 0;
+  if(input.haveSides) {
+    int right = input.right;
+    int left = input.left;
+    if(input.rightSound < 25) {
+      right = input.rightSound;
+      reasons |= REASON_RIGHT_SOUND;
+    }
+    if(input.leftSound < 20) {
+      left = input.leftSound;
+      reasons |= REASON_LEFT_SOUND;
+    }
+
+    if(abs(left-right) > 20 || turnMultiplier != 1) {
+      if(left > right + 20) {
+	if(right < 50 || turnMultiplier != 1) {
+	  direction = -60;
+	  reasons |= REASON_AWAY_FROM_RIGHT;
+	}
+      } else {
+	if(left < 70 || turnMultiplier != 1) {
+	  direction = 60;
+	  reasons |= REASON_AWAY_FROM_LEFT;
+	}
+      }
+    }
+  }
+
+  direction *= turnMultiplier;
+
+  if(input.mouseRead) {
+    if(input.mouseValid) {
+      if((forward && input.forwardSpeed > CONTROLLER_MOVING_SPEED) || (!forward && input.forwardSpeed < -CONTROLLER_MOVING_SPEED)) {
+	m_QuickRampup = false;
+	m_Moving = 10;
+	reasons |= REASON_MOVING;
+      } else if(m_Moving) {
+	m_Moving--;
+      }
+    } else {
+      m_Moving = 10;
+    }
+  }
+
+  bool updateSpeed = false;
+  if(!m_Moving && forward == m_LastForward) {
+    if(input.now - m_LastSpeedChange > 500 * NSEC_PER_MSEC) {
+      updateSpeed = true;
+    }
+  }
+
+  if(updateSpeed) {
+    reasons |= m_QuickRampup ? REASON_QUICK_RAMP : REASON_RAMP;
+    if(m_QuickRampup) {
+      if(forward) {
+	m_ForwardSpeed+=10;
+	if(m_ForwardSpeed >= m_MaxForwardSpeed) {
+	  m_ForwardSpeed = m_MaxForwardSpeed;
+	  m_QuickRampup = false;
+	}
+      } else {
+	m_ReverseSpeed-=10;
+	if(m_ReverseSpeed >= m_MaxReverseSpeed) {
+	  m_ReverseSpeed = m_MaxReverseSpeed;
+	  m_QuickRampup = false;
+	}
+      }
+    } else {
+      if(forward) {
+	m_ForwardSpeed+=2;
+      } else {
+	m_ReverseSpeed-=2;
+      }
+    }
+  }
+
+  output.forward = forward;
+  output.turnMultiplier = turnMultiplier;
+  output.direction = direction;
+  output.setSpeed = false;
+  output.speed = 0;
+  if(m_LastForward != forward || updateSpeed) {
+    if(m_LastForward != forward) {
+      reasons |= REASON_REVERSAL;
+      if(forward) {
+	m_MaxForwardSpeed = std::max<int>(m_MaxForwardSpeed, m_ForwardSpeed);
+	m_ForwardSpeed = m_InitialForwardSpeed;
+      } else {
+	m_MaxReverseSpeed = std::max<int>(m_MaxReverseSpeed, m_ReverseSpeed);
+	m_ReverseSpeed = m_InitialReverseSpeed;
+      }
+      m_QuickRampup = true;
+    }
+    output.setSpeed = true;
+    output.speed = forward ? m_ForwardSpeed : m_ReverseSpeed;
+    m_LastSpeedChange = input.now;
+    m_LastForward = forward;
+  }
+  output.reasons = reasons;
+  output.setDirection = (m_LastDirection != direction);
+  m_LastDirection = direction;
+  return output;
+}
@@ -0,0 +1,77 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stdint.h>
+
+/* Speed in mm/s that counts as moving */
+#define CONTROLLER_MOVING_SPEED 300
+
+/* The decision logic of the autonomous run: picks direction of travel,
+   steering and motor speed from the filtered distances and the mouse.
+   Free of I/O, so it can be replayed and benchmarked off the car. */
+class Controller
+{
+ public:
+  struct Input
+  {
+    uint64_t now;
+    bool haveFront;
+    int front;
+    bool haveSides;
+    int left;
+    int right;
+    int leftSound;
+    int rightSound;
+    bool mouseRead;   /* a mouse reading was due this cycle */
+    bool mouseValid;  /* and there is a mouse to take it from */
+    int forwardSpeed; /* mm/s, fused from all mice */
+    int lateralSpeed; /* mm/s, to the left */
+    int yawRate;      /* mrad/s, counter-clockwise */
+  };
+
+  /* The branches an update took, or-ed together in Output::reasons */
+  enum Reason {
+    REASON_FRONT_NEAR = 0x001,       /* front below 80, turning harder */
+    REASON_FRONT_CLOSE = 0x002,      /* front below 50, turning hardest */
+    REASON_FRONT_BLOCKED = 0x004,    /* reversing away from the front */
+    REASON_RIGHT_SOUND = 0x008,      /* right SRF08 below 25 replaced the IR */
+    REASON_LEFT_SOUND = 0x010,       /* left SRF08 below 20 replaced the IR */
+    REASON_AWAY_FROM_RIGHT = 0x020,  /* steering away from the right wall */
+    REASON_AWAY_FROM_LEFT = 0x040,   /* steering away from the left wall */
+    REASON_MOVING = 0x080,           /* the mouse saw the car move */
+    REASON_RAMP = 0x100,             /* not moving, speed raised */
+    REASON_QUICK_RAMP = 0x200,       /* raised in big steps back to the best speed */
+    REASON_REVERSAL = 0x400          /* direction of travel changed */
+  };
+
+  struct Output
+  {
+    int reasons;
+    bool forward;
+    int turnMultiplier;
+    int direction;
+    bool setSpeed;
+    int speed;
+    bool setDirection;
+  };
+
+  Controller(int initialForwardSpeed, int initialReverseSpeed);
+
+  void reset();
+  Output update(const Input& input);
+
+ private:
+  int m_InitialForwardSpeed;
+  int m_InitialReverseSpeed;
+
+  bool m_LastForward;
+  int m_LastDirection;
+  int m_ForwardSpeed;
+  int m_ReverseSpeed;
+  int m_MaxForwardSpeed;
+  int m_MaxReverseSpeed;
+  bool m_QuickRampup;
+  int m_Moving;
+  uint64_t m_LastSpeedChange;
+};
+#endif
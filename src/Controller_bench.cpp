@@ -0,0 +1,160 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include "Controller.h"
+#include "Telemetry.h"
+#include "Timing.h"
+
+/* Inputs of a control loop at 100 Hz with random but plausible distances */
+static void syntheticInputs(std::vector<Controller::Input>& inputs, int count)
+{
+  unsigned int seed = 1;
+  for(int i = 0; i < count; ++i) {
+    Controller::Input input;
+    input.now = i * 10 * NSEC_PER_MSEC;
+    input.haveFront = true;
+    input.front = 10 + rand_r(&seed) % 290;
+    input.haveSides = true;
+    input.left = 20 + rand_r(&seed) % 130;
+    input.right = 20 + rand_r(&seed) % 130;
+    input.leftSound = 10 + rand_r(&seed) % 290;
+    input.rightSound = 10 + rand_r(&seed) % 290;
+    input.mouseRead = (i % 6) == 5;
+    input.mouseValid = input.mouseRead;
+    input.forwardSpeed = ((int)(rand_r(&seed) % 201) - 100) * 16;
+    input.lateralSpeed = 0;
+    input.yawRate = 0;
+    inputs.push_back(input);
+  }
+}
+
+/* One input per recorded decision, from the raw ranges and mouse speeds
+   logged before it. Filters are not applied. */
+static bool recordedInputs(std::vector<Controller::Input>& inputs, const char* path)
+{
+  std::vector<TelemetryRecord> records;
+  if(!TelemetryLog::read(path, records)) {
+    return false;
+  }
+  int front = -1;
+  int left = -1;
+  int right = -1;
+  int leftSound = -1;
+  int rightSound = -1;
+  bool mouseRead = false;
+  int forwardSpeed = 0;
+  int lateralSpeed = 0;
+  int yawRate = 0;
+  for(size_t i = 0; i < records.size(); ++i) {
+    const TelemetryRecord& record = records[i];
+    if(record.type == TELEMETRY_RANGE) {
+      switch(record.id) {
+      case 0:
+        front = record.values[0];
+        break;
+      case 45:
+        right = record.values[0];
+        break;
+      case 135:
+        left = record.values[0];
+        break;
+      case 90:
+        rightSound = record.values[0];
+        break;
+      case 270:
+        leftSound = record.values[0];
+        break;
+      }
+    } else if(record.type == TELEMETRY_MOUSE) {
+      mouseRead = true;
+      forwardSpeed = record.values[0];
+      lateralSpeed = record.values[1];
+      yawRate = record.values[2];
+    } else if(record.type == TELEMETRY_DECISION) {
+      Controller::Input input;
+      input.now = record.time;
+      input.haveFront = front >= 0;
+      input.front = front;
+      input.haveSides = left >= 0 && right >= 0 && leftSound >= 0 && rightSound >= 0;
+      input.left = left;
+      input.right = right;
+      input.leftSound = leftSound;
+      input.rightSound = rightSound;
+      input.mouseRead = mouseRead;
+      input.mouseValid = mouseRead;
+      input.forwardSpeed = forwardSpeed;
+      input.lateralSpeed = lateralSpeed;
+      input.yawRate = yawRate;
+      inputs.push_back(input);
+      mouseRead = false;
+    }
+  }
+  return true;
+}
+
+static void bench(const char* name, const std::vector<Controller::Input>& inputs, int rounds)
+{
+  Controller controller(50, -90);
+  int checksum = 0;
+
+  /* Throughput over back to back calls */
+  uint64_t start = monotonicNs();
+  for(int round = 0; round < rounds; ++round) {
+    controller.reset();
+    for(size_t i = 0; i < inputs.size(); ++i) {
+      Controller::Output output = controller.update(inputs[i]);
+      checksum += output.direction + output.speed;
+    }
+  }
+  uint64_t elapsed = monotonicNs() - start;
+  uint64_t calls = (uint64_t)rounds * inputs.size();
+
+  /* Latency of single calls, less the cost of reading the clock */
+  uint64_t clockCost = monotonicNs();
+  for(int i = 0; i < 1000; ++i) {
+    monotonicNs();
+  }
+  clockCost = (monotonicNs() - clockCost) / 1001;
+
+  std::vector<uint64_t> latencies;
+  latencies.reserve(inputs.size());
+  controller.reset();
+  for(size_t i = 0; i < inputs.size(); ++i) {
+    uint64_t before = monotonicNs();
+    Controller::Output output = controller.update(inputs[i]);
+    uint64_t after = monotonicNs();
+    checksum += output.direction;
+    latencies.push_back((after - before > clockCost) ? after - before - clockCost : 0);
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  std::cout << name << ": " << calls << " decisions in " << elapsed / 1e6 << " ms, "
+            << calls * 1e3 / elapsed << " M decisions/s" << std::endl;
+  std::cout << "  latency ns: p50 " << latencies[latencies.size() / 2]
+            << ", p99 " << latencies[latencies.size() * 99 / 100]
+            << ", max " << latencies.back()
+            << " (checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, const char** argv)
+{
+  if(argc > 2) {
+    std::cout << argv[0] << " [telemetry log]" << std::endl;
+    return 1;
+  }
+
+  std::vector<Controller::Input> synthetic;
+  syntheticInputs(synthetic, 100000);
+  bench("synthetic", synthetic, 100);
+
+  if(argc == 2) {
+    std::vector<Controller::Input> recorded;
+    if(!recordedInputs(recorded, argv[1]) || recorded.empty()) {
+      std::cout << "Failed to read telemetry log " << argv[1] << std::endl;
+      return 1;
+    }
+    bench("recorded", recorded, 10000000 / recorded.size() + 1);
+  }
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include "EvdevSpeedSensor.h"
+#include "Timing.h"
+
+#include <iostream>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+EvdevSpeedSensor::EvdevSpeedSensor() :
+  m_DeltaX(0),
+  m_DeltaY(0)
+{
+}
+
+/* Event times are CLOCK_REALTIME unless asked otherwise. The emulated
+   event source is a FIFO that already uses CLOCK_MONOTONIC, so a failing
+   ioctl is only reported for real devices. */
+bool EvdevSpeedSensor::initialize(const char* device)
+{
+  if(!MouseSpeedSensor::initialize(device)) {
+    return false;
+  }
+  int clock = CLOCK_MONOTONIC;
+  if(ioctl(m_Fd, EVIOCSCLOCKID, &clock) != 0 && ioctl(m_Fd, EVIOCGVERSION, &clock) == 0) {
+    std::cout << "Failed to switch " << device << " to monotonic timestamps" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void EvdevSpeedSensor::drain(uint64_t now)
+{
+  struct input_event events[64];
+  int length;
+  while((length = read(m_Fd, events, sizeof(events))) > 0) {
+    for(size_t i = 0; i < length / sizeof(struct input_event); ++i) {
+      const struct input_event& event = events[i];
+      if(event.type == EV_REL && event.code == REL_X) {
+        m_DeltaX += event.value;
+      } else if(event.type == EV_REL && event.code == REL_Y) {
+        m_DeltaY += event.value;
+      } else if(event.type == EV_SYN && event.code == SYN_REPORT && (m_DeltaX || m_DeltaY)) {
+        uint64_t time = (uint64_t)event.time.tv_sec * NSEC_PER_SEC + event.time.tv_usec * NSEC_PER_USEC;
+        addMotion(time, m_DeltaX, -m_DeltaY);
+        m_DeltaX = m_DeltaY = 0;
+      } else if(event.type == EV_SYN && event.code == SYN_DROPPED) {
+        /* The kernel queue overflowed, the partial report is useless */
+        m_DeltaX = m_DeltaY = 0;
+      }
+    }
+  }
+}
@@ -0,0 +1,25 @@
+#ifndef EVDEV_SPEED_SENSOR_H
+#define EVDEV_SPEED_SENSOR_H
+
+#include <stdint.h>
+#include "MouseSpeedSensor.h"
+
+/* Reads one /dev/input/eventN device instead of the /dev/input/mice
+   multiplexer. Motion is taken at the kernel timestamp of each
+   SYN_REPORT, so scheduling delays of the reader do not show up in the
+   velocity. The y axis is flipped to match the PS/2 sensor. */
+class EvdevSpeedSensor: public MouseSpeedSensor
+{
+ public:
+  EvdevSpeedSensor();
+
+  virtual bool initialize(const char* device);
+
+ protected:
+  virtual void drain(uint64_t now);
+
+ private:
+  int m_DeltaX;
+  int m_DeltaY;
+};
+#endif
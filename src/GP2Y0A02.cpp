@@ -5,12 +5,13 @@ GP2Y0A02::GP2Y0A02(boost::shared_ptr<ADS1115> adc, uint8_t channel) : AnalogDist
 {
 }
 
-void GP2Y0A02::setupRanging()
+uint8_t GP2Y0A02::getGain()
 {
-    m_Adc->setGain(ADS1115_PGA_4P096);
+    return ADS1115_PGA_4P096;
 }
 
-uint16_t GP2Y0A02::voltageToRange(float millivolts)
+/* Generic curve from the datasheet, only evaluated to fill the lookup table */
+float GP2Y0A02::voltageToRange(float millivolts)
 {
   return 65*pow(((double)millivolts)/1000.0, -1.10);
 }
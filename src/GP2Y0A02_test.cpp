@@ -2,23 +2,35 @@
 #include <sstream>
 #include <unistd.h>
 #include <boost/shared_ptr.hpp>
+#include <wiringPi.h>
 #include "GP2Y0A02.h"
 
 int main(int argc, const char** argv)
 {
   int addr = 0;
   int channel = 0;
+  int alertPin = -1;
 
-  if(argc == 3) {
+  if(argc == 3 || argc == 4) {
     std::istringstream(argv[1]) >> std::hex >> addr;
     std::istringstream(argv[2]) >>  channel;
+    if(argc == 4) {
+      std::istringstream(argv[3]) >> alertPin;
+    }
   } else {
-    std::cout << argv[0] << " addr channel" << std::endl;
+    std::cout << argv[0] << " addr channel [alertPin]" << std::endl;
     return 1;
   }
 
   boost::shared_ptr<ADS1115> adc(new ADS1115(addr));
   adc->initialize();
+  if(alertPin >= 0) {
+    wiringPiSetupGpio();
+    if(!adc->enableConversionReadyPin(alertPin)) {
+      std::cout << "Failed to attach ALERT/RDY pin " << alertPin << std::endl;
+      return 1;
+    }
+  }
 
   GP2Y0A02 sensor(adc, channel);
 
@@ -33,6 +45,10 @@ int main(int argc, const char** argv)
   }
 
   std::cout << "range=" << sensor.getRange() << " cm" << std::endl;
+  if(alertPin >= 0) {
+    struct timespec ts = adc->getConversionTime();
+    std::cout << "converted at " << ts.tv_sec << "." << ts.tv_nsec << std::endl;
+  }
 
   return 0;
 }
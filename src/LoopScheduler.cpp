@@ -0,0 +1,110 @@
+#include "LoopScheduler.h"
+#include "Timing.h"
+
+#include <iomanip>
+
+LoopScheduler::LoopScheduler(int frequency) :
+  m_Period(NSEC_PER_SEC / ((frequency > 0) ? frequency : 1)),
+  m_Deadline(0),
+  m_CycleStart(0),
+  m_Cycles(0),
+  m_Overruns(0),
+  m_MaxJitter(0),
+  m_MaxWork(0)
+{
+  for(int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    m_Jitter[i] = 0;
+    m_Work[i] = 0;
+  }
+}
+
+void LoopScheduler::start()
+{
+  m_CycleStart = m_Deadline = monotonicNs();
+}
+
+/* Ends the work of the current cycle and sleeps until the next deadline. A
+   cycle that overran its deadline skips the missed slots instead of
+   running a burst of catch-up cycles. */
+void LoopScheduler::wait()
+{
+  uint64_t now = monotonicNs();
+  uint64_t work = now - m_CycleStart;
+  record(m_Work, work);
+  if(work > m_MaxWork) {
+    m_MaxWork = work;
+  }
+  m_Cycles++;
+
+  m_Deadline += m_Period;
+  if(now >= m_Deadline) {
+    m_Overruns++;
+    m_Deadline += ((now - m_Deadline) / m_Period + 1) * m_Period;
+  }
+  sleepUntilNs(m_Deadline);
+
+  m_CycleStart = monotonicNs();
+  uint64_t jitter = m_CycleStart - m_Deadline;
+  record(m_Jitter, jitter);
+  if(jitter > m_MaxJitter) {
+    m_MaxJitter = jitter;
+  }
+}
+
+uint64_t LoopScheduler::getCycleStart()
+{
+  return m_CycleStart;
+}
+
+uint64_t LoopScheduler::getPeriod()
+{
+  return m_Period;
+}
+
+uint64_t LoopScheduler::getCycles()
+{
+  return m_Cycles;
+}
+
+uint64_t LoopScheduler::getOverruns()
+{
+  return m_Overruns;
+}
+
+void LoopScheduler::record(uint64_t* histogram, uint64_t ns)
+{
+  uint64_t us = ns / NSEC_PER_USEC;
+  int bucket = 0;
+  while(us > 0 && bucket < HISTOGRAM_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  histogram[bucket]++;
+}
+
+void LoopScheduler::printHistogram(std::ostream& out, const char* name, const uint64_t* histogram)
+{
+  out << "  " << name << " histogram (us):" << std::endl;
+  for(int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+    if(!histogram[i]) {
+      continue;
+    }
+    uint64_t low = (i == 0) ? 0 : (1ULL << (i - 1));
+    out << "    " << std::setw(8) << low << " - ";
+    if(i == HISTOGRAM_BUCKETS - 1) {
+      out << std::setw(8) << "";
+    } else {
+      out << std::setw(8) << (1ULL << i);
+    }
+    out << ": " << histogram[i] << std::endl;
+  }
+}
+
+void LoopScheduler::printStatistics(std::ostream& out)
+{
+  out << "Control loop: " << m_Cycles << " cycles at " << m_Period / NSEC_PER_USEC << " us, "
+      << m_Overruns << " overruns, max work " << m_MaxWork / NSEC_PER_USEC
+      << " us, max jitter " << m_MaxJitter / NSEC_PER_USEC << " us" << std::endl;
+  printHistogram(out, "work", m_Work);
+  printHistogram(out, "jitter", m_Jitter);
+}
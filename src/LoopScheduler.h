@@ -0,0 +1,42 @@
+#ifndef LOOP_SCHEDULER_H
+#define LOOP_SCHEDULER_H
+
+#include <stdint.h>
+#include <ostream>
+
+/* Runs a loop at a fixed rate against absolute CLOCK_MONOTONIC deadlines,
+   so the period does not drift with the amount of work per cycle. Keeps
+   log2 histograms of the wake-up jitter and the work time per cycle. */
+class LoopScheduler
+{
+ public:
+  LoopScheduler(int frequency);
+
+  void start();
+  void wait();
+
+  uint64_t getCycleStart();
+  uint64_t getPeriod();
+  uint64_t getCycles();
+  uint64_t getOverruns();
+
+  void printStatistics(std::ostream& out);
+
+  /* Buckets are powers of two in microseconds, the last one is open ended */
+  static const int HISTOGRAM_BUCKETS = 20;
+
+ private:
+  static void record(uint64_t* histogram, uint64_t ns);
+  static void printHistogram(std::ostream& out, const char* name, const uint64_t* histogram);
+
+  uint64_t m_Period;
+  uint64_t m_Deadline;
+  uint64_t m_CycleStart;
+  uint64_t m_Cycles;
+  uint64_t m_Overruns;
+  uint64_t m_MaxJitter;
+  uint64_t m_MaxWork;
+  uint64_t m_Jitter[HISTOGRAM_BUCKETS];
+  uint64_t m_Work[HISTOGRAM_BUCKETS];
+};
+#endif
@@ -4,30 +4,73 @@
 
 Motor::Motor(boost::shared_ptr<Adafruit_PWMServoDriver> pwm, uint8_t channel, uint16_t maxReverse, uint16_t maxForward) :
   m_Servo(pwm, channel, maxReverse, maxForward),
-  m_CurrentSpeed(0)
+  m_CurrentSpeed(0),
+  m_Phase(MOTOR_DRIVING),
+  m_PhaseStart(0)
 {
   m_Servo.setDirection(0);
 }
 
+/* Returns immediately. Going from forward to reverse starts the brake
+   sequence, update() applies the reverse speed once it is done. */
 void Motor::setSpeed(int speed)
 {
-  if(speed >= 0 || m_CurrentSpeed < 0) {
-    m_Servo.setDirection(speed);
-  } else {
+  if(m_Phase != MOTOR_DRIVING) {
+    if(speed < 0) {
+      /* Still on the way to reverse, only the target changes */
+      m_CurrentSpeed = speed;
+      return;
+    }
+    m_Phase = MOTOR_DRIVING;
+  } else if(speed < 0 && m_CurrentSpeed >= 0) {
     /* Break */
     m_Servo.setDirection(-1000);
-    usleep(100 * 1000);
-    /* Stop motor */
-    m_Servo.setDirection(0);
-    usleep(100 * 1000);
-    /* And finally set requested reverse speed */
-    m_Servo.setDirection(speed);
+    m_Phase = MOTOR_BRAKING;
+    m_PhaseStart = monotonicNs();
+    m_CurrentSpeed = speed;
+    return;
   }
+  m_Servo.setDirection(speed);
   m_CurrentSpeed = speed;
 }
 
+/* Advance the brake sequence, call this every control cycle */
+void Motor::update(uint64_t now)
+{
+  switch(m_Phase) {
+    case MOTOR_BRAKING:
+      if(now >= m_PhaseStart + MOTOR_BRAKE_TIME) {
+	/* Stop motor */
+	m_Servo.setDirection(0);
+	m_Phase = MOTOR_NEUTRAL;
+	m_PhaseStart = now;
+      }
+      break;
+    case MOTOR_NEUTRAL:
+      if(now >= m_PhaseStart + MOTOR_NEUTRAL_TIME) {
+	/* And finally set requested reverse speed */
+	m_Servo.setDirection(m_CurrentSpeed);
+	m_Phase = MOTOR_DRIVING;
+      }
+      break;
+    case MOTOR_DRIVING:
+      break;
+  }
+}
+
+void Motor::setDeadband(uint16_t ticks)
+{
+  m_Servo.setDeadband(ticks);
+}
+
+Motor::Phase Motor::getPhase()
+{
+  return m_Phase;
+}
+
 void Motor::breakMotor()
 {
+  m_Phase = MOTOR_DRIVING;
   if(m_CurrentSpeed > 50) {
     m_Servo.setDirection(-1000);
     m_CurrentSpeed = -1000;
@@ -3,20 +3,37 @@
 
 #include <stdint.h>
 #include "Servo.h"
+#include "Timing.h"
 #include "Adafruit_PWMServoDriver.h"
 
 #include <boost/shared_ptr.hpp>
 
+/* The ESC only goes into reverse after braking and then returning to
+   neutral, each phase has to be held this long */
+#define MOTOR_BRAKE_TIME (100 * NSEC_PER_MSEC)
+#define MOTOR_NEUTRAL_TIME (100 * NSEC_PER_MSEC)
+
 class Motor
 {
  public:
+  enum Phase {
+    MOTOR_DRIVING,
+    MOTOR_BRAKING,
+    MOTOR_NEUTRAL
+  };
+
   Motor(boost::shared_ptr<Adafruit_PWMServoDriver> pwm, uint8_t channel, uint16_t maxReverse, uint16_t maxForward);
 
   void setSpeed(int speed);
   void breakMotor();
+  void setDeadband(uint16_t ticks);
+  void update(uint64_t now);
+  Phase getPhase();
 
  private:
   Servo m_Servo;
   int m_CurrentSpeed;
+  Phase m_Phase;
+  uint64_t m_PhaseStart;
 };
 #endif
@@ -1,15 +1,39 @@
 #include "MouseSpeedSensor.h"
+#include "Timing.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/epoll.h>
 
-MouseSpeedSensor::MouseSpeedSensor(): m_Fd(-1)
+/* Also wake up without packets, so the velocity drops to 0 when the
+   mouse stops */
+#define MOUSE_IDLE_TIMEOUT_MS 10
+
+MouseSpeedSensor::MouseSpeedSensor() :
+  m_Fd(-1),
+  m_Epoll(-1),
+  m_Window(MOUSE_DEFAULT_WINDOW_MS * NSEC_PER_MSEC),
+  m_CountsPerMeter(MOUSE_DEFAULT_COUNTS_PER_METER),
+  m_PendingLength(0),
+  m_HistoryCount(0),
+  m_Telemetry(NULL),
+  m_TelemetryId(0),
+  m_Running(false)
 {
+  m_Position.x = 0;
+  m_Position.y = 0;
+  m_Position.time = 0;
 }
 
 MouseSpeedSensor::~MouseSpeedSensor()
 {
+  stop();
+  if(m_Epoll != -1) {
+    close(m_Epoll);
+  }
   if(m_Fd != -1) {
     close(m_Fd);
   }
@@ -18,16 +42,161 @@ MouseSpeedSensor::~MouseSpeedSensor()
 bool MouseSpeedSensor::initialize(const char* device)
 {
   m_Fd = open(device, O_RDWR | O_NONBLOCK);
-  return (m_Fd != -1);
+  if(m_Fd == -1) {
+    return false;
+  }
+  m_Epoll = epoll_create1(0);
+  if(m_Epoll == -1) {
+    return false;
+  }
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = m_Fd;
+  return epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Fd, &event) == 0;
+}
+
+void MouseSpeedSensor::setWindow(int ms)
+{
+  if(ms > 0) {
+    m_Window = ms * NSEC_PER_MSEC;
+  }
+}
+
+void MouseSpeedSensor::setCountsPerMeter(double counts)
+{
+  if(counts > 0) {
+    m_CountsPerMeter = counts;
+  }
+}
+
+/* Every packet the reader thread takes is logged with this id */
+void MouseSpeedSensor::setTelemetry(TelemetryLog* telemetry, int id)
+{
+  m_Telemetry = telemetry;
+  m_TelemetryId = id;
+}
+
+bool MouseSpeedSensor::start()
+{
+  if(m_Running || m_Epoll == -1) {
+    return false;
+  }
+  /* Whatever queued up before is stale */
+  uint8_t data[256];
+  while(read(m_Fd, data, sizeof(data)) > 0) {
+  }
+  m_PendingLength = 0;
+  m_HistoryCount = 0;
+  addMotion(monotonicNs(), 0, 0);
+  publish(m_Position.time);
+
+  m_Running = true;
+  if(pthread_create(&m_Thread, NULL, &MouseSpeedSensor::threadMain, this) != 0) {
+    m_Running = false;
+    return false;
+  }
+  return true;
+}
+
+void MouseSpeedSensor::stop()
+{
+  if(m_Running) {
+    m_Running = false;
+    pthread_join(m_Thread, NULL);
+  }
 }
 
 MouseSpeedSensor::MouseSpeed MouseSpeedSensor::getSpeed()
 {
-  MouseSpeed speed = {0,0};
-  int8_t data[3];
-  if(read(m_Fd, data, sizeof(data)) == sizeof(data)) {
-    speed.x = data[1];
-    speed.y = data[2];
+  return m_State.read().speed;
+}
+
+MouseSpeedSensor::Position MouseSpeedSensor::getPosition()
+{
+  return m_State.read().position;
+}
+
+MouseSpeedSensor::Position MouseSpeedSensor::getDisplacement(const Position& mark)
+{
+  Position position = getPosition();
+  position.x -= mark.x;
+  position.y -= mark.y;
+  position.time -= mark.time;
+  return position;
+}
+
+void* MouseSpeedSensor::threadMain(void* arg)
+{
+  static_cast<MouseSpeedSensor*>(arg)->readPackets();
+  return NULL;
+}
+
+void MouseSpeedSensor::readPackets()
+{
+  while(m_Running) {
+    struct epoll_event event;
+    int events = epoll_wait(m_Epoll, &event, 1, MOUSE_IDLE_TIMEOUT_MS);
+    uint64_t now = monotonicNs();
+    if(events > 0) {
+      drain(now);
+    }
+    publish(now);
   }
-  return speed;
+}
+
+/* PS/2 packets carry no time, they all get the time of the wakeup.
+   A packet split across reads is completed by the next one. */
+void MouseSpeedSensor::drain(uint64_t now)
+{
+  uint8_t data[MOUSE_PS2_PACKET_SIZE * 64];
+  int pending = m_PendingLength;
+  memcpy(data, m_Pending, pending);
+  int length;
+  while((length = read(m_Fd, data + pending, sizeof(data) - pending)) > 0) {
+    length += pending;
+    int offset = 0;
+    for(; offset + MOUSE_PS2_PACKET_SIZE <= length; offset += MOUSE_PS2_PACKET_SIZE) {
+      addMotion(now, (int8_t)data[offset + 1], (int8_t)data[offset + 2]);
+    }
+    pending = length - offset;
+    memmove(data, data + offset, pending);
+  }
+  memcpy(m_Pending, data, pending);
+  m_PendingLength = pending;
+}
+
+void MouseSpeedSensor::addMotion(uint64_t time, int dx, int dy)
+{
+  /* start() seeds the history before the reader runs, that is no packet */
+  if(m_Telemetry && m_Running) {
+    m_Telemetry->log(time, TELEMETRY_MOUSE_PACKET, m_TelemetryId, dx, dy);
+  }
+  m_Position.x += dx;
+  m_Position.y += dy;
+  m_Position.time = time;
+  m_History[m_HistoryCount++ % MOUSE_HISTORY_SIZE] = m_Position;
+}
+
+/* The velocity is the motion since the newest entry at least one window
+   old, or since the oldest one while the history is shorter than that.
+   Once the mouse stops, that is the last entry and the velocity is 0. */
+void MouseSpeedSensor::publish(uint64_t now)
+{
+  uint32_t oldest = (m_HistoryCount > MOUSE_HISTORY_SIZE) ? m_HistoryCount - MOUSE_HISTORY_SIZE : 0;
+  uint32_t index = m_HistoryCount - 1;
+  while(index > oldest && m_History[index % MOUSE_HISTORY_SIZE].time + m_Window > now) {
+    --index;
+  }
+  const Position& start = m_History[index % MOUSE_HISTORY_SIZE];
+  uint64_t elapsed = std::max<uint64_t>(now - start.time, m_Window);
+
+  /* Positions are summed up in counts, only what is published is scaled */
+  double mmPerCount = 1000.0 / m_CountsPerMeter;
+  State state;
+  state.position.x = m_Position.x * mmPerCount;
+  state.position.y = m_Position.y * mmPerCount;
+  state.position.time = m_Position.time;
+  state.speed.x = (m_Position.x - start.x) * mmPerCount * NSEC_PER_SEC / elapsed;
+  state.speed.y = (m_Position.y - start.y) * mmPerCount * NSEC_PER_SEC / elapsed;
+  m_State.write(state);
 }
@@ -2,23 +2,86 @@
 #define MOUSE_SPEED_SENSOR_H
 
 #include <stdint.h>
+#include <pthread.h>
+#include "SeqLock.h"
+#include "Telemetry.h"
 
+/* Enough packets for any velocity window at the 100-200 Hz a PS/2 mouse reports */
+#define MOUSE_HISTORY_SIZE 256
+#define MOUSE_DEFAULT_WINDOW_MS 50
+/* A 400 cpi mouse */
+#define MOUSE_DEFAULT_COUNTS_PER_METER 15748
+#define MOUSE_PS2_PACKET_SIZE 3
+
+/* Drains the mouse in a thread of its own. Every packet is timestamped
+   and summed up, the decision thread gets the velocity over a sliding
+   window and the position through a sequence lock. This class reads
+   PS/2 packets as /dev/input/mice delivers them, forward motion gives
+   negative y. */
 class MouseSpeedSensor
 {
  public:
   MouseSpeedSensor();
-  ~MouseSpeedSensor();
-  bool initialize(const char* device);
+  virtual ~MouseSpeedSensor();
+  virtual bool initialize(const char* device);
+  void setWindow(int ms);
+  void setCountsPerMeter(double counts);
+  void setTelemetry(TelemetryLog* telemetry, int id);
+
+  bool start();
+  void stop();
 
+  /* Millimeters per second */
   struct MouseSpeed
   {
     int x;
     int y;
   };
 
+  /* Millimeters since start(), usable as a mark for getDisplacement() */
+  struct Position
+  {
+    int64_t x;
+    int64_t y;
+    uint64_t time;
+  };
+
   MouseSpeed getSpeed();
+  Position getPosition();
+  Position getDisplacement(const Position& mark);
 
  private:
+  struct State
+  {
+    Position position;
+    MouseSpeed speed;
+  };
+
+  static void* threadMain(void* arg);
+  void readPackets();
+  void publish(uint64_t now);
+
+ protected:
+  /* Read everything the device has, called from the reader thread */
+  virtual void drain(uint64_t now);
+  void addMotion(uint64_t time, int dx, int dy);
+
   int m_Fd;
+
+ private:
+  int m_Epoll;
+  uint64_t m_Window;
+  double m_CountsPerMeter;
+  uint8_t m_Pending[MOUSE_PS2_PACKET_SIZE];
+  int m_PendingLength;
+  Position m_History[MOUSE_HISTORY_SIZE];
+  uint32_t m_HistoryCount;
+  Position m_Position;
+  SeqLock<State> m_State;
+  TelemetryLog* m_Telemetry;
+  int m_TelemetryId;
+
+  pthread_t m_Thread;
+  volatile bool m_Running;
 };
 #endif
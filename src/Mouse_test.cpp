@@ -1,35 +1,29 @@
-#include <stdio.h>
+#include <iostream>
 #include <unistd.h>
-#include <fcntl.h>
+#include <string>
+#include <boost/shared_ptr.hpp>
+#include "MouseSpeedSensor.h"
+#include "EvdevSpeedSensor.h"
 
 int main(int argc, char** argv)
 {
-  int fd, bytes;
-  unsigned char data[3];
-  
-  const char *pDevice = "/dev/input/mice";
-  
+  const char *pDevice = (argc > 1) ? argv[1] : "/dev/input/mice";
+
+  bool evdev = argc > 2 && std::string(argv[2]) == "evdev";
+
   // Open Mouse
-  fd = open(pDevice, O_RDWR);
-  if (fd == -1) {
-    printf("ERROR Opening %s\n", pDevice);
+  boost::shared_ptr<MouseSpeedSensor> mouse(evdev ? new EvdevSpeedSensor() : new MouseSpeedSensor());
+  if(!mouse->initialize(pDevice) || !mouse->start()) {
+    std::cout << "ERROR Opening " << pDevice << std::endl;
     return -1;
   }
-  
-  int left, middle, right;
-  signed char x, y;
+
+  MouseSpeedSensor::Position mark = mouse->getPosition();
   while (1) {
-    // Read Mouse     
-    bytes = read(fd, data, sizeof(data));
-    
-    if (bytes > 0) {
-      left = data[0] & 0x1;
-      right = data[0] & 0x2;
-      middle = data[0] & 0x4;
-      x = data[1];
-      y = data[2];
-      printf("x=%d, y=%d, left=%d, middle=%d, right=%d\n", x, y, left, middle, right);
-    }   
+    usleep(100 * 1000);
+    MouseSpeedSensor::MouseSpeed speed = mouse->getSpeed();
+    MouseSpeedSensor::Position moved = mouse->getDisplacement(mark);
+    std::cout << "vx=" << speed.x << " mm/s, vy=" << speed.y << " mm/s, moved x=" << moved.x << " mm, y=" << moved.y << " mm" << std::endl;
   }
-  return 0; 
+  return 0;
 }
@@ -5,15 +5,30 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/foreach.hpp>
-#include <boost/circular_buffer.hpp>
 #include <ncursesw/ncurses.h>
 #include <wiringPi.h>
 #include "GP2Y0A02.h"
+#include "LoopScheduler.h"
+#include "SensorAcquisition.h"
+#include "SensorFilter.h"
+#include "Timing.h"
+#include "Trace.h"
 
+/* Room for about 10 s of records at 100 Hz with all drivers tracing */
+#define TRACE_CAPACITY_LOG2 16
+/* Telemetry records waiting for the flush thread, several seconds worth */
+#define TELEMETRY_CAPACITY_LOG2 14
 
 int main(int argc, const char** argv)
 {
   Robot robot;
+  /* robot [cfg] replay log */
+  if(argc > 2 && strcmp(argv[1], "replay") == 0) {
+    return robot.replay("robot.json", argv[2]) ? 0 : 1;
+  }
+  if(argc > 3 && strcmp(argv[2], "replay") == 0) {
+    return robot.replay(argv[1], argv[3]) ? 0 : 1;
+  }
   robot.initialize((argc > 1) ? argv[1] : "robot.json");
   if(argc > 2 && strcmp(argv[2], "manual") == 0) {
     robot.runManual();
@@ -25,12 +40,52 @@ int main(int argc, const char** argv)
   return 0;
 }
 
-Robot::Robot() : m_InitialForwardSpeed(0), m_InitialReverseSpeed(0), m_Running(true), m_IoService(), m_Signals(m_IoService, SIGINT, SIGTERM)
+/* Build the filter chain from the optional "filter" array of a sensor entry */
+static SensorFilter readFilter(const boost::property_tree::ptree& sensor)
+{
+  SensorFilter filter;
+  boost::optional<const boost::property_tree::ptree&> stages = sensor.get_child_optional("filter");
+  if(!stages) {
+    return filter;
+  }
+  BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, *stages) {
+    std::string type = child.second.get<std::string>("type");
+    bool added = false;
+    if(type == "median") {
+      added = filter.addMedian(child.second.get<int>("window"));
+    } else if(type == "ema") {
+      added = filter.addEma(child.second.get<float>("alpha"));
+    } else if(type == "clamp") {
+      added = filter.addClamp(child.second.get<int>("min"), child.second.get<int>("max"));
+    } else {
+      std::cout << "Filter type " << type << " is unknown" << std::endl;
+      continue;
+    }
+    if(!added) {
+      std::cout << "Invalid or too many " << type << " filter stages, a median has to come first" << std::endl;
+    }
+  }
+  return filter;
+}
+
+static void printCommand(std::ostream& out, bool set, int value)
+{
+  if(set) {
+    out << value;
+  } else {
+    out << "-";
+  }
+}
+
+Robot::Robot() : m_FrontSlot(-1), m_RightSlot(-1), m_LeftSlot(-1), m_RightSoundSlot(-1), m_LeftSoundSlot(-1), m_InitialForwardSpeed(0), m_InitialReverseSpeed(0), m_LoopFrequency(100), m_AcquisitionFrequency(200), m_Running(true), m_IoService(), m_Signals(m_IoService, SIGINT, SIGTERM)
 {
 }
 
 Robot::~Robot()
 {
+  if(m_SensorAcquisition) {
+    m_SensorAcquisition->stop();
+  }
   m_PWMDrivers.clear();
   m_SRF08Sensors.clear();
 }
@@ -40,6 +95,18 @@ void Robot::initialize(const char* cfg)
   boost::property_tree::ptree pt;
   boost::property_tree::json_parser::read_json(cfg, pt);
 
+  std::string telemetryFile = pt.get<std::string>("robot.telemetryFile", "");
+  if(!telemetryFile.empty() && !m_Telemetry.open(telemetryFile.c_str(), TELEMETRY_CAPACITY_LOG2)) {
+    std::cout << "Failed to open telemetry log " << telemetryFile << std::endl;
+  }
+  m_TraceFile = pt.get<std::string>("robot.traceFile", "");
+  if(!m_TraceFile.empty() && !Trace::initialize(TRACE_CAPACITY_LOG2)) {
+    std::cout << "Failed to set up tracing" << std::endl;
+  }
+
+  /* GPIO numbering must be set up before ADCs install their ALERT/RDY handlers */
+  wiringPiSetupGpio();
+
   try {
     m_InitialForwardSpeed = pt.get<int>("robot.initialForwardSpeed");
   } catch(boost::property_tree::ptree_error& e) {
@@ -50,6 +117,8 @@ void Robot::initialize(const char* cfg)
   } catch(boost::property_tree::ptree_error& e) {
     std::cout << "Failed to read inititial reverse speed" << std::endl;
   }
+  m_LoopFrequency = pt.get<int>("robot.loopFrequency", m_LoopFrequency);
+  m_AcquisitionFrequency = pt.get<int>("robot.acquisitionFrequency", m_AcquisitionFrequency);
   try {
     BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, pt.get_child("robot.pwm")) {
       std::string name = child.second.get<std::string>("name");
@@ -64,12 +133,14 @@ void Robot::initialize(const char* cfg)
     throw;
   }
 
+  boost::shared_ptr<Adafruit_PWMServoDriver> steeringPwm;
   try {
     int channel = pt.get<int>("robot.steering.channel");
     int maxLeft = pt.get<int>("robot.steering.maxLeft");
     int maxRight = pt.get<int>("robot.steering.maxRight");
-    boost::shared_ptr<Adafruit_PWMServoDriver> pwm = m_PWMDrivers.at(pt.get<std::string>("robot.steering.pwm"));
-    m_Steering = boost::shared_ptr<Servo>(new Servo(pwm, channel, maxLeft, maxRight));
+    steeringPwm = m_PWMDrivers.at(pt.get<std::string>("robot.steering.pwm"));
+    m_Steering = boost::shared_ptr<Servo>(new Servo(steeringPwm, channel, maxLeft, maxRight));
+    m_Steering->setDeadband(pt.get<int>("robot.steering.deadband", 0));
   } catch(boost::property_tree::ptree_error& e) {
     std::cout << "Failed to read steering servo configuration" << std::endl;
     throw;
@@ -84,6 +155,7 @@ void Robot::initialize(const char* cfg)
     int maxReverse = pt.get<int>("robot.motor.maxReverse");
     boost::shared_ptr<Adafruit_PWMServoDriver> pwm = m_PWMDrivers.at(pt.get<std::string>("robot.motor.pwm"));
     m_Motor = boost::shared_ptr<Motor>(new Motor(pwm, channel, maxReverse, maxForward));
+    m_Motor->setDeadband(pt.get<int>("robot.motor.deadband", 0));
   } catch(boost::property_tree::ptree_error& e) {
     std::cout << "Failed to read motor configuration" << std::endl;
     throw;
@@ -92,6 +164,16 @@ void Robot::initialize(const char* cfg)
     throw;
   }
 
+  std::vector<boost::shared_ptr<Adafruit_PWMServoDriver> > drivers;
+  for(std::map<std::string, boost::shared_ptr<Adafruit_PWMServoDriver> >::const_iterator iter=m_PWMDrivers.begin(); iter!=m_PWMDrivers.end(); ++iter) {
+    drivers.push_back(iter->second);
+  }
+  /* The steering servo only picks up a new pulse once per PWM period */
+  int actuatorFrequency = pt.get<int>("robot.actuator.frequency", (int)steeringPwm->getPWMFreq());
+  m_Actuator = boost::shared_ptr<Actuator>(new Actuator(m_Motor, m_Steering, drivers, actuatorFrequency));
+  m_Actuator->setSteeringSlew(pt.get<int>("robot.actuator.steeringSlew", 0));
+  m_Actuator->setThrottleSlew(pt.get<int>("robot.actuator.throttleSlew", 0));
+
   try {
     BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, pt.get_child("robot.ADCs")) {
       std::string type = child.second.get<std::string>("type");
@@ -100,6 +182,18 @@ void Robot::initialize(const char* cfg)
 	std::string name = child.second.get<std::string>("name");
 	boost::shared_ptr<ADS1115> adc(new ADS1115(addr));
 	adc->initialize();
+	boost::optional<int> alertPin = child.second.get_optional<int>("alertPin");
+	if(alertPin && !adc->enableConversionReadyPin(*alertPin)) {
+	  std::cout << "Failed to attach ALERT/RDY pin " << *alertPin << " of ADC " << name << ", polling instead" << std::endl;
+	}
+	if(child.second.get<bool>("scan", false)) {
+	  int rate = ADS1115Scanner::rateFromSamplesPerSecond(child.second.get<int>("rate", 860));
+	  if(rate < 0) {
+	    std::cout << "Unsupported scan rate for ADC " << name << std::endl;
+	  } else {
+	    m_ADS1115Scanners.insert(std::pair<std::string, boost::shared_ptr<ADS1115Scanner> >(name, boost::shared_ptr<ADS1115Scanner>(new ADS1115Scanner(adc, rate))));
+	  }
+	}
 	m_ADS1115ADCs.insert(std::pair<std::string, boost::shared_ptr<ADS1115> >(name, adc));
       } else {
 	std::cout << "ADC type " << type << " is unknown" << std::endl;
@@ -110,6 +204,7 @@ void Robot::initialize(const char* cfg)
     throw;
   }
 
+  std::map<int, SensorFilter> filters;
   try {
     BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, pt.get_child("robot.sensors")) {
       std::string type = child.second.get<std::string>("type");
@@ -117,38 +212,76 @@ void Robot::initialize(const char* cfg)
         int addr = child.second.get<int>("address");
 	int angle = child.second.get<int>("angle");
 	boost::shared_ptr<srf08> sensor(new srf08(addr));
+	boost::optional<int> maxRange = child.second.get_optional<int>("maxRange");
+	if(maxRange && !sensor->setMaxRange(*maxRange)) {
+	  std::cout << "Failed to set range of SRF08 at " << angle << " degrees" << std::endl;
+	}
+	boost::optional<int> gain = child.second.get_optional<int>("gain");
+	if(gain && !sensor->setGain(*gain)) {
+	  std::cout << "Failed to set gain of SRF08 at " << angle << " degrees" << std::endl;
+	}
+	boost::optional<int> echoes = child.second.get_optional<int>("echoes");
+	if(echoes && !sensor->setEchoCount(*echoes)) {
+	  std::cout << "Unsupported echo count for SRF08 at " << angle << " degrees" << std::endl;
+	}
 	sensor->initiateRanging();
 	m_SRF08Sensors.insert(std::pair<int, boost::shared_ptr<srf08> >(angle, sensor));
+	filters[angle] = readFilter(child.second);
       } else if(type =="analog") {
           std::string driver = child.second.get<std::string>("driver");
           int channel = child.second.get<int>("channel");
           int angle = child.second.get<int>("angle");
+          std::string adcName = child.second.get<std::string>("adc");
           boost::shared_ptr<ADS1115> adc;
           try {
-              adc = m_ADS1115ADCs.at(child.second.get<std::string>("adc"));
+              adc = m_ADS1115ADCs.at(adcName);
           } catch(std::out_of_range& e) {
               std::cout << "Non-existing ADC for analog sensor" << std::endl;
               continue;
           }
           if(driver == "GP2Y0A02") {
               boost::shared_ptr<GP2Y0A02> sensor(new GP2Y0A02(adc, channel));
+              boost::optional<const boost::property_tree::ptree&> calibration = child.second.get_child_optional("calibration");
+              if(calibration) {
+                std::vector<AnalogDistanceSensor::CalibrationPoint> points;
+                BOOST_FOREACH(const boost::property_tree::ptree::value_type& point, *calibration) {
+                  AnalogDistanceSensor::CalibrationPoint p;
+                  p.millivolts = point.second.get<float>("millivolts");
+                  p.range = point.second.get<int>("range");
+                  points.push_back(p);
+                }
+                sensor->setCalibration(points);
+              }
+              sensor->buildTable();
+              std::map<std::string, boost::shared_ptr<ADS1115Scanner> >::const_iterator scanner = m_ADS1115Scanners.find(adcName);
+              if(scanner != m_ADS1115Scanners.end()) {
+                sensor->attachScanner(scanner->second);
+              }
               m_AnalogDistanceSensors.insert(std::pair<int, boost::shared_ptr<AnalogDistanceSensor> >(angle, sensor));
+              filters[angle] = readFilter(child.second);
           } else {
               std::cout << "Analog sensor driver " << driver << " is unknown" << std::endl;
           }
       } else if(type == "speed") {
         std::string driver = child.second.get<std::string>("driver");
-        if(driver == "mouse") {
-          if(m_MouseSpeedSensor) {
-            std::cout << "Only one mouse speed sensor is currently supported!" << std::endl;
-            continue;
-          }
+        if(driver == "mouse" || driver == "evdev") {
           std::string device = child.second.get<std::string>("device");
-          m_MouseSpeedSensor.reset(new MouseSpeedSensor());
-          if(!m_MouseSpeedSensor->initialize(device.c_str())) {
+          boost::shared_ptr<MouseSpeedSensor> sensor;
+          if(driver == "evdev") {
+            sensor.reset(new EvdevSpeedSensor());
+          } else {
+            sensor.reset(new MouseSpeedSensor());
+          }
+          if(!sensor->initialize(device.c_str())) {
             std::cout << "Failed to initialize mouse speed sensor at " << device << std::endl;
-            m_MouseSpeedSensor.reset();
+            continue;
           }
+          sensor->setWindow(child.second.get<int>("window", MOUSE_DEFAULT_WINDOW_MS));
+          sensor->setCountsPerMeter(child.second.get<double>("countsPerMeter", MOUSE_DEFAULT_COUNTS_PER_METER));
+          sensor->setTelemetry(&m_Telemetry, m_SpeedFusion.getSensorCount());
+          /* Mounting position in mm, x forward and y to the left */
+          m_SpeedFusion.addSensor(sensor, child.second.get<double>("x", 0), child.second.get<double>("y", 0),
+                                  child.second.get<double>("angle", 0));
         } else {
           std::cout << "Speed sensor driver " << driver << " is unknown" << std::endl;
         }
@@ -161,9 +294,39 @@ void Robot::initialize(const char* cfg)
     throw;
   }
 
+  boost::shared_ptr<SRF08Scheduler> srf08Scheduler(new SRF08Scheduler(m_SRF08Sensors));
+  boost::optional<boost::property_tree::ptree&> schedule = pt.get_child_optional("robot.srf08Schedule");
+  if(schedule) {
+    BOOST_FOREACH(const boost::property_tree::ptree::value_type& group, *schedule) {
+      std::vector<int> angles;
+      BOOST_FOREACH(const boost::property_tree::ptree::value_type& angle, group.second) {
+        angles.push_back(angle.second.get_value<int>());
+      }
+      if(!srf08Scheduler->addGroup(angles)) {
+        std::cout << "SRF08 schedule refers to a non-existing sensor" << std::endl;
+      }
+    }
+  }
+  m_SensorAcquisition.reset(new SensorAcquisition(srf08Scheduler, m_AnalogDistanceSensors, m_AcquisitionFrequency));
+  m_SensorHistory.assign(m_SensorAcquisition->getSlotCount(), SensorHistory());
+  m_SensorFilters.assign(m_SensorAcquisition->getSlotCount(), SensorFilter());
+  for(int slot = 0; slot < m_SensorAcquisition->getSlotCount(); ++slot) {
+    m_SensorFilters[slot] = filters[m_SensorAcquisition->getAngle(slot)];
+  }
+  m_FrontSlot = m_SensorAcquisition->getSlot(0);
+  m_RightSlot = m_SensorAcquisition->getSlot(45);
+  m_LeftSlot = m_SensorAcquisition->getSlot(135);
+  m_RightSoundSlot = m_SensorAcquisition->getSlot(90);
+  m_LeftSoundSlot = m_SensorAcquisition->getSlot(270);
+  if(m_FrontSlot < 0) {
+    std::cout << "No front distance sensor configured" << std::endl;
+  }
+  if(m_LeftSlot < 0 || m_RightSlot < 0 || m_LeftSoundSlot < 0 || m_RightSoundSlot < 0) {
+    std::cout << "Side distance sensors incomplete, steering disabled" << std::endl;
+  }
+
   m_LedPin = 14;
   m_ButtonPin = 15;
-  wiringPiSetupGpio();
   /* LED is output and default off */
   pinMode(m_LedPin, OUTPUT);
   m_LedState = false;
@@ -186,192 +349,112 @@ void Robot::run()
   }
   digitalWrite(m_LedPin, HIGH);
 
-  std::map<int, boost::shared_ptr<AnalogDistanceSensor> >::const_iterator analogIter=m_AnalogDistanceSensors.end();
-
-  std::map<int, boost::circular_buffer<int> > distances;
-  bool lastForward = false;
-  int lastDirection = 0;
-
-  int forwardSpeed = m_InitialForwardSpeed;
-  int reverseSpeed = m_InitialReverseSpeed;
-  int maxForwardSpeed = m_InitialForwardSpeed;
-  int maxReverseSpeed = m_InitialReverseSpeed;
-  bool quickRampup = false;
-  int moving = 0;
+  std::vector<uint32_t> lastSequence(m_SensorAcquisition->getSlotCount(), 0);
+  Controller controller(m_InitialForwardSpeed, m_InitialReverseSpeed);
   int readSpeedCounter = 0;
 
-  struct timespec lastSpeedChange = {0,0};
+  startScanners();
+  if(!m_SensorAcquisition->start()) {
+    std::cout << "Failed to start sensor acquisition" << std::endl;
+    stopScanners();
+    return;
+  }
+  if(!m_Actuator->start()) {
+    std::cout << "Failed to start actuator" << std::endl;
+    m_SensorAcquisition->stop();
+    stopScanners();
+    return;
+  }
+  bool haveMouse = m_SpeedFusion.getSensorCount() > 0;
+  if(haveMouse && !m_SpeedFusion.start()) {
+    std::cout << "Failed to start mouse speed sensors" << std::endl;
+    haveMouse = false;
+  }
 
+  LoopScheduler scheduler(m_LoopFrequency);
+  scheduler.start();
   while(m_Running) {
     /* Sense */
-    for(std::map<int, boost::shared_ptr<srf08> >::const_iterator iter=m_SRF08Sensors.begin(); iter!=m_SRF08Sensors.end(); ++iter) {
-      if(iter->second->rangingComplete()) {
-        std::map<int, boost::circular_buffer<int> >::iterator dIter = distances.find(iter->first);
-        if(dIter == distances.end()) {
-          distances.insert(std::pair<int, boost::circular_buffer<int> >(iter->first, boost::circular_buffer<int>(10)));
-          dIter = distances.find(iter->first);
+    TraceScope senseTrace(TRACE_SENSE);
+    for(int slot = 0; slot < m_SensorAcquisition->getSlotCount(); ++slot) {
+      SensorAcquisition::Sample sample = m_SensorAcquisition->getSample(slot);
+      if(sample.sequence != lastSequence[slot]) {
+        m_SensorHistory[slot].push(sample.range, sample.time);
+        m_SensorFilters[slot].update(m_SensorHistory[slot]);
+        m_Telemetry.log(sample.time, TELEMETRY_RANGE, m_SensorAcquisition->getAngle(slot), sample.range,
+                        m_SensorFilters[slot].getValue(), (int32_t)m_SensorFilters[slot].getVariance());
+        for(int echo = 1; echo < sample.echoCount; ++echo) {
+          m_Telemetry.log(sample.time, TELEMETRY_ECHO, m_SensorAcquisition->getAngle(slot), echo, sample.echoes[echo]);
         }
-        int range = iter->second->getRange();
-        dIter->second.push_back(range);
-        iter->second->initiateRanging();
+        lastSequence[slot] = sample.sequence;
       }
     }
 
-    if(analogIter==m_AnalogDistanceSensors.end()) {
-      analogIter=m_AnalogDistanceSensors.begin();
-      analogIter->second->initiateRanging();
-    }
-    else if(analogIter->second->rangingComplete()) {
-        std::map<int, boost::circular_buffer<int> >::iterator dIter = distances.find(analogIter->first);
-        if(dIter == distances.end()) {
-          distances.insert(std::pair<int, boost::circular_buffer<int> >(analogIter->first, boost::circular_buffer<int>(10)));
-          dIter = distances.find(analogIter->first);
-        }
-        int range = analogIter->second->getRange();
-        dIter->second.push_back(range);
-
-      ++analogIter;
-      if(analogIter==m_AnalogDistanceSensors.end()) {
-        analogIter=m_AnalogDistanceSensors.begin();
-      }
-      analogIter->second->initiateRanging();
-    }
+    senseTrace.stop();
 
     /* Decide */
-    bool forward = true;
-    int turnMultiplier = 1;
-    std::map<int, boost::circular_buffer<int> >::iterator dIter = distances.find(0);
-    if(!dIter->second.empty()) {
-      if(dIter->second.back() < 80) {
-	turnMultiplier = 2;
-      }
-      if(dIter->second.back() < 50) {
-	turnMultiplier = 4;
-      }
-      if(dIter->second.back() < 30 || (!lastForward && dIter->second.back() < 50)) {
-        turnMultiplier = -2;
-	forward = false;
-      }
-    }
-
-    int direction = 0;
-    std::map<int, boost::circular_buffer<int> >::iterator leftDistance = distances.find(135);
-    std::map<int, boost::circular_buffer<int> >::iterator rightDistance = distances.find(45);
-
-    std::map<int, boost::circular_buffer<int> >::iterator leftSoundDistance = distances.find(270);
-    std::map<int, boost::circular_buffer<int> >::iterator rightSoundDistance = distances.find(90);
-
-    if(!leftDistance->second.empty() && !rightDistance->second.empty() && !leftSoundDistance->second.empty() && !rightSoundDistance->second.empty()) {
-      int right = rightDistance->second.back();
-      int left = leftDistance->second.back();
-      if(rightSoundDistance->second.back() < 25) {
-	right = rightSoundDistance->second.back();
-      }
-      if(leftSoundDistance->second.back() < 20) {
-	left = leftSoundDistance->second.back();
-      }
-
-      if(abs(left-right) > 20 || turnMultiplier != 1) {
-	if(left > right + 20) {
-	  if(right < 50 || turnMultiplier != 1) {
-	    direction = -60;
-	  }
-	} else {
-	  if(left < 70 || turnMultiplier != 1) {
-	    direction = 60;
-	  }
-	}
-      }
+    TraceScope decideTrace(TRACE_DECIDE);
+    Controller::Input input;
+    input.now = scheduler.getCycleStart();
+    input.haveFront = m_FrontSlot >= 0 && !m_SensorFilters[m_FrontSlot].empty();
+    input.front = input.haveFront ? m_SensorFilters[m_FrontSlot].getValue() : 0;
+    input.haveSides = m_LeftSlot >= 0 && m_RightSlot >= 0 && m_LeftSoundSlot >= 0 && m_RightSoundSlot >= 0 &&
+      !m_SensorFilters[m_LeftSlot].empty() && !m_SensorFilters[m_RightSlot].empty() &&
+      !m_SensorFilters[m_LeftSoundSlot].empty() && !m_SensorFilters[m_RightSoundSlot].empty();
+    if(input.haveSides) {
+      input.left = m_SensorFilters[m_LeftSlot].getValue();
+      input.right = m_SensorFilters[m_RightSlot].getValue();
+      input.leftSound = m_SensorFilters[m_LeftSoundSlot].getValue();
+      input.rightSound = m_SensorFilters[m_RightSoundSlot].getValue();
     }
-
-    direction *= turnMultiplier;
-
+    input.mouseRead = false;
+    input.mouseValid = false;
     if(readSpeedCounter++ == 5) {
-      if(m_MouseSpeedSensor) {
-	MouseSpeedSensor::MouseSpeed speed = m_MouseSpeedSensor->getSpeed();
-	if((forward && speed.y < -50) || (!forward && speed.y > 50)) {
-	  quickRampup = false;
-	  moving = 10;
-	} else if(moving) {
-	  moving--;
-	}
-      } else {
-	moving = 10;
+      input.mouseRead = true;
+      if(haveMouse) {
+	SpeedFusion::Motion motion = m_SpeedFusion.getMotion();
+	input.mouseValid = true;
+	input.forwardSpeed = motion.forward;
+	input.lateralSpeed = motion.lateral;
+	input.yawRate = motion.yawRate;
+	m_Telemetry.log(input.now, TELEMETRY_MOUSE, 0, motion.forward, motion.lateral, motion.yawRate);
       }
       readSpeedCounter = 0;
     }
 
-    bool updateSpeed = false;
-    if(!moving && forward == lastForward) {
-      struct timespec spec;
-       clock_gettime(CLOCK_MONOTONIC, &spec);
-       if(spec.tv_sec == lastSpeedChange.tv_sec) {
-         if(spec.tv_nsec - lastSpeedChange.tv_nsec > 1000000*500) {
-           updateSpeed = true;
-         }
-       } else if(spec.tv_sec == lastSpeedChange.tv_sec + 1) {
-         if(1000000000 - lastSpeedChange.tv_nsec + spec.tv_nsec > 1000000*500) {
-           updateSpeed = true;
-         }
-       } else {
-         updateSpeed = true;
-       }
-    }
+    Controller::Output output = controller.update(input);
+    m_Telemetry.log(input.now, TELEMETRY_DECISION, output.reasons, output.forward, output.turnMultiplier, output.direction);
+    decideTrace.stop();
 
-    if(updateSpeed) {
-      if(quickRampup) {
-	if(forward) {
-	  forwardSpeed+=10;
-	  if(forwardSpeed >= maxForwardSpeed) {
-	    forwardSpeed = maxForwardSpeed;
-	    quickRampup = false;
-	  }
-	} else {
-	  reverseSpeed-=10;
-	  if(reverseSpeed >= maxReverseSpeed) {
-	    reverseSpeed = maxReverseSpeed;
-	    quickRampup = false;
-	  }
-	}
-      } else {
-	if(forward) {
-	  forwardSpeed+=2;
-	} else {
-	  reverseSpeed-=2;
-	}
-      }
-    }
-
-    /* Actuate */
-    if(lastForward != forward || updateSpeed) {
-      if(lastForward != forward) {
-	if(forward) {
-	  maxForwardSpeed = std::max<int>(maxForwardSpeed, forwardSpeed);
-	  forwardSpeed = m_InitialForwardSpeed;
-	} else {
-	  maxReverseSpeed = std::max<int>(maxReverseSpeed, reverseSpeed);
-	  reverseSpeed = m_InitialReverseSpeed;
-	}
-	quickRampup = true;
-      }
-      if(forward) {
-        m_Motor->setSpeed(forwardSpeed);
-      } else {
-	m_Motor->setSpeed(reverseSpeed);
-      }
-      clock_gettime(CLOCK_MONOTONIC, &lastSpeedChange);
-      lastForward = forward;
+    /* Actuate, the actuator thread moves toward the new targets */
+    if(output.setSpeed) {
+      m_Actuator->setSpeed(output.speed);
+      m_Telemetry.log(input.now, TELEMETRY_MOTOR, 0, output.speed);
     }
-    if(lastDirection != direction) {
-      m_Steering->setDirection(direction);
-      lastDirection = direction;
+    if(output.setDirection) {
+      m_Actuator->setDirection(output.direction);
+      m_Telemetry.log(input.now, TELEMETRY_STEERING, 0, output.direction);
     }
-    usleep(1000 * 10);
     m_IoService.poll();
+    TraceScope sleepTrace(TRACE_SLEEP);
+    scheduler.wait();
+  }
+  m_SensorAcquisition->stop();
+  stopScanners();
+  m_Actuator->stop();
+  m_SpeedFusion.stop();
+  m_Telemetry.close();
+  if(m_Telemetry.getRecords()) {
+    std::cout << "Telemetry: " << m_Telemetry.getRecords() << " records, " << m_Telemetry.getDropped() << " dropped" << std::endl;
+  }
+  if(!m_TraceFile.empty() && !Trace::writeChromeTrace(m_TraceFile.c_str())) {
+    std::cout << "Failed to write trace to " << m_TraceFile << std::endl;
   }
 
   m_Motor->setSpeed(0);
   m_Steering->setDirection(0);
+  scheduler.printStatistics(std::cout);
+  m_SensorAcquisition->printStatistics(std::cout);
 
 #if 0
   /* Go forward at 10% of top speed for five seconds */
@@ -396,6 +479,158 @@ void Robot::run()
 #endif
 }
 
+/* Feed a telemetry log through the current filters and decision logic
+   as fast as possible. Prints the motor and steering commands the
+   current code produces next to the recorded ones, marking differences
+   with '*'. Returns true when everything matched. */
+bool Robot::replay(const char* cfg, const char* log)
+{
+  boost::property_tree::ptree pt;
+  boost::property_tree::json_parser::read_json(cfg, pt);
+  m_InitialForwardSpeed = pt.get<int>("robot.initialForwardSpeed", 0);
+  m_InitialReverseSpeed = pt.get<int>("robot.initialReverseSpeed", 0);
+  std::map<int, SensorFilter> filters;
+  std::map<int, SensorHistory> histories;
+  BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, pt.get_child("robot.sensors")) {
+    boost::optional<int> angle = child.second.get_optional<int>("angle");
+    if(angle) {
+      filters[*angle] = readFilter(child.second);
+    }
+  }
+
+  std::vector<TelemetryRecord> records;
+  if(!TelemetryLog::read(log, records)) {
+    std::cout << "Failed to read telemetry log " << log << std::endl;
+    return false;
+  }
+  bool haveMouse = false;
+  for(size_t i = 0; i < records.size(); ++i) {
+    if(records[i].type == TELEMETRY_MOUSE) {
+      haveMouse = true;
+    }
+  }
+
+  Controller controller(m_InitialForwardSpeed, m_InitialReverseSpeed);
+  Controller::Input input;
+  Controller::Output output = Controller::Output();
+  bool inCycle = false;
+  bool mouseRecorded = false;
+  SpeedFusion::Motion mouse = {0, 0, 0};
+  int readSpeedCounter = 0;
+  bool recordedSpeed = false;
+  int recordedSpeedValue = 0;
+  bool recordedDirection = false;
+  int recordedDirectionValue = 0;
+  uint64_t startTime = records.empty() ? 0 : records[0].time;
+  uint64_t cycles = 0;
+  uint64_t decisionMismatches = 0;
+  uint64_t commandMismatches = 0;
+  std::ostringstream commands;
+
+  uint64_t wallStart = monotonicNs();
+  for(size_t i = 0; i <= records.size(); ++i) {
+    bool end = (i == records.size());
+    if(inCycle && (end || records[i].type == TELEMETRY_DECISION)) {
+      double ms = (input.now - startTime) / 1e6;
+      if(output.setSpeed || recordedSpeed) {
+        bool differs = output.setSpeed != recordedSpeed || output.speed != recordedSpeedValue;
+        commandMismatches += differs;
+        commands << (differs ? "* " : "  ") << ms << " ms motor ";
+        printCommand(commands, output.setSpeed, output.speed);
+        commands << " recorded ";
+        printCommand(commands, recordedSpeed, recordedSpeedValue);
+        commands << std::endl;
+      }
+      if(output.setDirection || recordedDirection) {
+        bool differs = output.setDirection != recordedDirection || output.direction != recordedDirectionValue;
+        commandMismatches += differs;
+        commands << (differs ? "* " : "  ") << ms << " ms steering ";
+        printCommand(commands, output.setDirection, output.direction);
+        commands << " recorded ";
+        printCommand(commands, recordedDirection, recordedDirectionValue);
+        commands << std::endl;
+      }
+      inCycle = false;
+    }
+    if(end) {
+      break;
+    }
+
+    const TelemetryRecord& record = records[i];
+    switch(record.type) {
+    case TELEMETRY_RANGE:
+      histories[record.id].push(record.values[0], record.time);
+      filters[record.id].update(histories[record.id]);
+      break;
+    case TELEMETRY_MOUSE:
+      mouse.forward = record.values[0];
+      mouse.lateral = record.values[1];
+      mouse.yawRate = record.values[2];
+      mouseRecorded = true;
+      break;
+    case TELEMETRY_MOTOR:
+      recordedSpeed = true;
+      recordedSpeedValue = record.values[0];
+      break;
+    case TELEMETRY_STEERING:
+      recordedDirection = true;
+      recordedDirectionValue = record.values[0];
+      break;
+    case TELEMETRY_DECISION:
+      {
+        input.now = record.time;
+        std::map<int, SensorFilter>::const_iterator front = filters.find(0);
+        input.haveFront = front != filters.end() && !front->second.empty();
+        input.front = input.haveFront ? front->second.getValue() : 0;
+        std::map<int, SensorFilter>::const_iterator left = filters.find(135);
+        std::map<int, SensorFilter>::const_iterator right = filters.find(45);
+        std::map<int, SensorFilter>::const_iterator leftSound = filters.find(270);
+        std::map<int, SensorFilter>::const_iterator rightSound = filters.find(90);
+        input.haveSides = left != filters.end() && right != filters.end() && leftSound != filters.end() && rightSound != filters.end() &&
+          !left->second.empty() && !right->second.empty() && !leftSound->second.empty() && !rightSound->second.empty();
+        if(input.haveSides) {
+          input.left = left->second.getValue();
+          input.right = right->second.getValue();
+          input.leftSound = leftSound->second.getValue();
+          input.rightSound = rightSound->second.getValue();
+        }
+        input.mouseRead = false;
+        input.mouseValid = false;
+        if(readSpeedCounter++ == 5) {
+          input.mouseRead = true;
+          input.mouseValid = haveMouse;
+          input.forwardSpeed = mouse.forward;
+          input.lateralSpeed = mouse.lateral;
+          input.yawRate = mouse.yawRate;
+          readSpeedCounter = 0;
+        }
+        if(mouseRecorded != (input.mouseRead && haveMouse)) {
+          std::cout << "Mouse reads out of step at " << (record.time - startTime) / 1e6 << " ms" << std::endl;
+        }
+        mouseRecorded = false;
+
+        output = controller.update(input);
+        cycles++;
+        if(output.reasons != record.id || output.forward != (record.values[0] != 0) || output.turnMultiplier != record.values[1] ||
+           output.direction != record.values[2]) {
+          decisionMismatches++;
+        }
+        recordedSpeed = false;
+        recordedDirection = false;
+        inCycle = true;
+      }
+      break;
+    }
+  }
+  uint64_t wallTime = monotonicNs() - wallStart;
+
+  std::cout << commands.str();
+  std::cout << "Replayed " << cycles << " cycles (" << (cycles ? (records.back().time - startTime) / 1e9 : 0) << " s) in "
+            << wallTime / 1e6 << " ms, " << (wallTime ? cycles * 1e9 / wallTime : 0) << " cycles/s" << std::endl;
+  std::cout << decisionMismatches << " decisions and " << commandMismatches << " commands differ from the recording" << std::endl;
+  return decisionMismatches == 0 && commandMismatches == 0;
+}
+
 void Robot::runManual()
 {
   int startx = 0;
@@ -404,11 +639,17 @@ void Robot::runManual()
   int speed = 0;
   int turn = 0;
 
-  std::map<int, boost::shared_ptr<AnalogDistanceSensor> >::const_iterator analogIter=m_AnalogDistanceSensors.end();
+  AnalogSensorMap::const_iterator analogIter=m_AnalogDistanceSensors.end();
 
   WINDOW *win;
   int c;
 
+  if(!m_Actuator->start()) {
+    std::cout << "Failed to start actuator" << std::endl;
+    return;
+  }
+  startScanners();
+
   initscr();
   clear();
   noecho();
@@ -434,7 +675,7 @@ void Robot::runManual()
       }
       ++i;
     }
-    for(std::map<int, boost::shared_ptr<AnalogDistanceSensor> >::const_iterator iter=m_AnalogDistanceSensors.begin(); iter!=m_AnalogDistanceSensors.end(); ++iter) {
+    for(AnalogSensorMap::const_iterator iter=m_AnalogDistanceSensors.begin(); iter!=m_AnalogDistanceSensors.end(); ++iter) {
       if(iter->second->rangingComplete()) {
 	mvwprintw(win, 3+i, 2, "Analog sensor at %u degrees: %u cm", iter->first, iter->second->getRange());
       } else {
@@ -466,7 +707,7 @@ void Robot::runManual()
         if(speed < 1000)
         {
           speed++;
-          m_Motor->setSpeed(speed);
+          m_Actuator->setSpeed(speed);
         }
         break;
         // Decrease speed
@@ -474,7 +715,7 @@ void Robot::runManual()
         if(speed > -1000)
         {
           speed--;
-          m_Motor->setSpeed(speed);
+          m_Actuator->setSpeed(speed);
         }
         break;
         // Increase left turn
@@ -482,7 +723,7 @@ void Robot::runManual()
         if(turn > -1000)
         {
           turn--;
-          m_Steering->setDirection(turn);
+          m_Actuator->setDirection(turn);
         }
         break;
         // Increase right turn
@@ -490,7 +731,7 @@ void Robot::runManual()
         if(turn < 1000)
         {
           turn++;
-          m_Steering->setDirection(turn);
+          m_Actuator->setDirection(turn);
         }
         break;
         // Stop robot
@@ -498,16 +739,16 @@ void Robot::runManual()
       case 'S':
         speed = 0;
         turn = 0;
-        m_Motor->setSpeed(speed);
-        m_Steering->setDirection(turn);
+        m_Actuator->setSpeed(speed);
+        m_Actuator->setDirection(turn);
         break;
         // Stop robot and exit
       case 'q':
       case 'Q':
         speed = 0;
         turn = 0;
-        m_Motor->setSpeed(speed);
-        m_Steering->setDirection(turn);
+        m_Actuator->setSpeed(speed);
+        m_Actuator->setDirection(turn);
         m_Running = false;
         break;
       case 'a':
@@ -520,14 +761,13 @@ void Robot::runManual()
 	}
 
 	if(analogIter==m_AnalogDistanceSensors.end()) {
-	  analogIter=m_AnalogDistanceSensors.begin();
-	  analogIter->second->initiateRanging();
+	  analogIter=SensorAcquisition::nextPolledAnalogSensor(m_AnalogDistanceSensors, analogIter);
+	  if(analogIter!=m_AnalogDistanceSensors.end()) {
+	    analogIter->second->initiateRanging();
+	  }
 	}
 	else if(analogIter->second->rangingComplete()) {
-	  ++analogIter;
-	  if(analogIter==m_AnalogDistanceSensors.end()) {
-	    analogIter=m_AnalogDistanceSensors.begin();
-	  }
+	  analogIter=SensorAcquisition::nextPolledAnalogSensor(m_AnalogDistanceSensors, analogIter);
 	  analogIter->second->initiateRanging();
 	}
 	break;
@@ -547,10 +787,31 @@ void Robot::runManual()
   refresh();
   endwin();
 
+  stopScanners();
+  m_Actuator->stop();
+
   m_Motor->setSpeed(0);
   m_Steering->setDirection(0);
 }
 
+/* The scanners run only while something reads them, SensorAcquisition in
+   run() or the sensor display in runManual() */
+void Robot::startScanners()
+{
+  for(std::map<std::string, boost::shared_ptr<ADS1115Scanner> >::const_iterator iter=m_ADS1115Scanners.begin(); iter!=m_ADS1115Scanners.end(); ++iter) {
+    if(!iter->second->start()) {
+      std::cout << "Failed to start scanner for ADC " << iter->first << std::endl;
+    }
+  }
+}
+
+void Robot::stopScanners()
+{
+  for(std::map<std::string, boost::shared_ptr<ADS1115Scanner> >::const_iterator iter=m_ADS1115Scanners.begin(); iter!=m_ADS1115Scanners.end(); ++iter) {
+    iter->second->stop();
+  }
+}
+
 void Robot::signalHandler(const boost::system::error_code& ec, int signalNumber)
 {
   std::cout << "Terminating robot" << std::endl;
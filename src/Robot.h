@@ -4,10 +4,19 @@
 #include "Adafruit_PWMServoDriver.h"
 #include "Servo.h"
 #include "Motor.h"
+#include "Actuator.h"
 #include "SRF08.h"
 #include "AnalogDistanceSensor.h"
 #include "ADS1115.h"
+#include "ADS1115Scanner.h"
 #include "MouseSpeedSensor.h"
+#include "EvdevSpeedSensor.h"
+#include "SpeedFusion.h"
+#include "SensorAcquisition.h"
+#include "SensorHistory.h"
+#include "SensorFilter.h"
+#include "Telemetry.h"
+#include "Controller.h"
 
 #include <stdint.h>
 #include <boost/shared_ptr.hpp>
@@ -15,6 +24,7 @@
 #include <boost/asio/impl/io_service.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <map>
+#include <vector>
 #include <string>
 
 class Robot
@@ -26,22 +36,39 @@ class Robot
   void initialize(const char* cfg);
   void run();
   void runManual();
+  bool replay(const char* cfg, const char* log);
 
  private:
+  void startScanners();
+  void stopScanners();
   void signalHandler(const boost::system::error_code& ec, int signalNumber);
 
  private:
   boost::shared_ptr<Servo> m_Steering;
   boost::shared_ptr<Motor> m_Motor;
+  boost::shared_ptr<Actuator> m_Actuator;
   std::map<std::string, boost::shared_ptr<Adafruit_PWMServoDriver> > m_PWMDrivers;
   std::map<int, boost::shared_ptr<srf08> > m_SRF08Sensors;
   std::map<int, boost::shared_ptr<AnalogDistanceSensor> > m_AnalogDistanceSensors;
   std::map<std::string, boost::shared_ptr<ADS1115> > m_ADS1115ADCs;
-  boost::shared_ptr<MouseSpeedSensor> m_MouseSpeedSensor;
+  std::map<std::string, boost::shared_ptr<ADS1115Scanner> > m_ADS1115Scanners;
+  boost::shared_ptr<SensorAcquisition> m_SensorAcquisition;
+  std::vector<SensorHistory> m_SensorHistory;
+  std::vector<SensorFilter> m_SensorFilters;
+  int m_FrontSlot;
+  int m_RightSlot;
+  int m_LeftSlot;
+  int m_RightSoundSlot;
+  int m_LeftSoundSlot;
   int m_ButtonPin;
   int m_LedPin;
   int m_InitialForwardSpeed;
   int m_InitialReverseSpeed;
+  int m_LoopFrequency;
+  int m_AcquisitionFrequency;
+  std::string m_TraceFile;
+  TelemetryLog m_Telemetry;
+  SpeedFusion m_SpeedFusion;
   bool m_LedState;
   bool m_Running;
 
@@ -2,39 +2,92 @@
 
 #include <unistd.h>
 #include <wiringPiI2C.h>
+#include "Trace.h"
 
 #define CHECK_RETURN(x) if((x) == -1) { return false; }
 
-srf08::srf08(uint8_t addr)
+srf08::srf08(uint8_t addr) : m_Address(addr), m_RangeRegister(SRF08_DEFAULT_RANGE), m_ReadyTime(0), m_Valid(false), m_LightLevel(0), m_EchoCount(1)
 {
+  m_Echoes[0] = 0;
   m_Fd = wiringPiI2CSetup(addr / 2);
 }
 
 bool srf08::initiateRanging()
 {
+  TraceScope trace(TRACE_I2C_WRITE, m_Address);
   if(wiringPiI2CWriteReg8(m_Fd, 0, 0x51)) {
     return false;
   }
+  m_ReadyTime = monotonicNs() + getRangingTime();
+  m_Valid = false;
   return true;
 }
 
-
+/* The sensor does not answer on the bus while ranging, so do not ask
+   before the ranging time is up. Once it is, one block read fetches the
+   results and getRange()/getLightLevel() are served from that. */
 bool srf08::rangingComplete()
 {
-  return (wiringPiI2CReadReg8(m_Fd, 0) != -1);
+  if(m_Valid) {
+    return true;
+  }
+  if(monotonicNs() < m_ReadyTime) {
+    return false;
+  }
+  uint8_t buf[SRF08_ECHO_REGISTER + 2 * SRF08_MAX_ECHOES];
+  int length = SRF08_ECHO_REGISTER + 2 * m_EchoCount;
+  TraceScope trace(TRACE_I2C_READ, m_Address);
+  if(wiringPiI2CReadBlockData(m_Fd, 0, length, buf) != length) {
+    return false;
+  }
+  m_LightLevel = buf[1];
+  for(int i = 0; i < m_EchoCount; ++i) {
+    m_Echoes[i] = (buf[SRF08_ECHO_REGISTER + 2*i] << 8) | buf[SRF08_ECHO_REGISTER + 2*i + 1];
+  }
+  m_Valid = true;
+  return true;
 }
 
 uint8_t srf08::getLightLevel()
 {
+  if(m_Valid) {
+    return m_LightLevel;
+  }
+  TraceScope trace(TRACE_I2C_READ, m_Address);
   int val = wiringPiI2CReadReg8(m_Fd, 1);
   return (val == -1) ? 0 : val;
 }
 
 uint16_t srf08::getRange()
 {
-  uint8_t msb = wiringPiI2CReadReg8(m_Fd, 2);
-  uint8_t lsb = wiringPiI2CReadReg8(m_Fd, 3);
-  return (msb << 8) | lsb;
+  return m_Echoes[0];
+}
+
+/* How many echoes to fetch with each result, each one adds two bytes
+   to the block read */
+bool srf08::setEchoCount(int count)
+{
+  if(count < 1 || count > SRF08_MAX_ECHOES) {
+    return false;
+  }
+  m_EchoCount = count;
+  m_Valid = false;
+  return true;
+}
+
+/* Copy the echoes of the last ping, nearest first. Returns how many were
+   found, reading stops at the first empty register. */
+int srf08::getEchoes(uint16_t* ranges, int maxRanges)
+{
+  if(!m_Valid) {
+    return 0;
+  }
+  int count = 0;
+  while(count < m_EchoCount && count < maxRanges && m_Echoes[count]) {
+    ranges[count] = m_Echoes[count];
+    count++;
+  }
+  return count;
 }
 
 bool srf08::changeAddress(uint8_t addr)
@@ -48,3 +101,42 @@ bool srf08::changeAddress(uint8_t addr)
   m_Fd = wiringPiI2CSetup(addr/2);
   return true;
 }
+
+/* Shorter ranges finish sooner. The register is volatile, it is back at
+   11 m after every power cycle. */
+bool srf08::setMaxRange(uint16_t cm)
+{
+  int steps = (cm * 10 + SRF08_MM_PER_RANGE_STEP - 1) / SRF08_MM_PER_RANGE_STEP;
+  if(steps < 1) {
+    steps = 1;
+  } else if(steps > SRF08_DEFAULT_RANGE + 1) {
+    steps = SRF08_DEFAULT_RANGE + 1;
+  }
+  TraceScope trace(TRACE_I2C_WRITE, m_Address);
+  CHECK_RETURN(wiringPiI2CWriteReg8(m_Fd, 2, steps - 1));
+  m_RangeRegister = steps - 1;
+  return true;
+}
+
+/* Maximum analog gain, 0 (94) to 31 (1025). With a reduced range the gain
+   should come down too, or echoes of the previous ping get picked up. */
+bool srf08::setGain(uint8_t gain)
+{
+  if(gain > SRF08_MAX_GAIN) {
+    return false;
+  }
+  TraceScope trace(TRACE_I2C_WRITE, m_Address);
+  CHECK_RETURN(wiringPiI2CWriteReg8(m_Fd, 1, gain));
+  return true;
+}
+
+uint16_t srf08::getMaxRange()
+{
+  return (m_RangeRegister + 1) * SRF08_MM_PER_RANGE_STEP / 10;
+}
+
+/* Nanoseconds from initiateRanging() until the result is available */
+uint32_t srf08::getRangingTime()
+{
+  return (m_RangeRegister + 1) * SRF08_NS_PER_RANGE_STEP;
+}
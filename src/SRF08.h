@@ -3,6 +3,18 @@
 
 #include <stdint.h>
 
+/* Each step of the range register adds 43 mm, and the echo of that takes
+   about 251 us to come back */
+#define SRF08_MM_PER_RANGE_STEP 43
+#define SRF08_NS_PER_RANGE_STEP 250729
+#define SRF08_DEFAULT_RANGE 255
+#define SRF08_MAX_GAIN 31
+/* Registers 0 and 1 hold the software revision and the light level,
+   the echoes follow as 16 bit values. An SMBus block is at most 32 bytes,
+   so one read covers 15 of the 17 echoes. */
+#define SRF08_ECHO_REGISTER 2
+#define SRF08_MAX_ECHOES 15
+
 class srf08
 {
  public:
@@ -13,10 +25,24 @@ class srf08
 
   uint8_t getLightLevel();
   uint16_t getRange();
+  bool setEchoCount(int count);
+  int getEchoes(uint16_t* ranges, int maxRanges);
 
   bool changeAddress(uint8_t addr);
 
+  bool setMaxRange(uint16_t cm);
+  bool setGain(uint8_t gain);
+  uint16_t getMaxRange();
+  uint32_t getRangingTime();
+
  private:
   int m_Fd;
+  uint8_t m_Address;
+  uint8_t m_RangeRegister;
+  uint64_t m_ReadyTime;
+  bool m_Valid;
+  uint8_t m_LightLevel;
+  int m_EchoCount;
+  uint16_t m_Echoes[SRF08_MAX_ECHOES];
 };
 #endif
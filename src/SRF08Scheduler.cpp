@@ -0,0 +1,155 @@
+#include "SRF08Scheduler.h"
+#include "Timing.h"
+
+#include <iterator>
+
+SRF08Scheduler::SRF08Scheduler(const SRF08SensorMap& sensors) :
+  m_Sensors(sensors),
+  m_Current(0),
+  m_Fired(false),
+  m_FireTime(0),
+  m_Window(0)
+{
+  for(SRF08SensorMap::const_iterator iter=m_Sensors.begin(); iter!=m_Sensors.end(); ++iter) {
+    SensorState state;
+    state.pending = false;
+    state.samples = 0;
+    state.timeouts = 0;
+    state.firstSample = 0;
+    state.lastSample = 0;
+    m_States[iter->first] = state;
+  }
+}
+
+/* Add a group of sensors that fire together. Sensors left out of every
+   group are fired in a group of their own. */
+bool SRF08Scheduler::addGroup(const std::vector<int>& angles)
+{
+  Group group;
+  for(std::vector<int>::const_iterator iter=angles.begin(); iter!=angles.end(); ++iter) {
+    SRF08SensorMap::iterator sensor = m_Sensors.find(*iter);
+    if(sensor == m_Sensors.end()) {
+      return false;
+    }
+    group.angles.push_back(*iter);
+    group.indices.push_back(std::distance(m_Sensors.begin(), sensor));
+  }
+  if(!group.angles.empty()) {
+    m_Groups.push_back(group);
+  }
+  return true;
+}
+
+const SRF08SensorMap& SRF08Scheduler::getSensors()
+{
+  return m_Sensors;
+}
+
+/* Advance the firing pattern, storing finished pings in readings.
+   Returns the number of readings stored. */
+int SRF08Scheduler::update(uint64_t now, Reading* readings, int maxReadings)
+{
+  if(m_Sensors.empty()) {
+    return 0;
+  }
+  if(!m_Fired) {
+    addUngrouped();
+    fire(now);
+    return 0;
+  }
+  if(now - m_FireTime < m_Window) {
+    return 0;
+  }
+
+  /* The window is over, collect what has finished. A sensor still busy
+     gets one more window before it is given up on. */
+  int count = 0;
+  bool busy = false;
+  const Group& group = m_Groups[m_Current];
+  for(size_t i = 0; i < group.angles.size(); ++i) {
+    SensorState& state = m_States[group.angles[i]];
+    if(!state.pending) {
+      continue;
+    }
+    boost::shared_ptr<srf08> sensor = m_Sensors[group.angles[i]];
+    if(sensor->rangingComplete()) {
+      if(count < maxReadings) {
+        readings[count].angle = group.angles[i];
+        readings[count].index = group.indices[i];
+        /* No echo means nothing closer than the programmed range */
+        int range = sensor->getRange();
+        readings[count].range = range ? range : sensor->getMaxRange();
+        readings[count].time = m_FireTime;
+        readings[count].echoCount = sensor->getEchoes(readings[count].echoes, SRF08_MAX_ECHOES);
+        count++;
+      }
+      if(!state.samples) {
+        state.firstSample = now;
+      }
+      state.lastSample = now;
+      state.samples++;
+      state.pending = false;
+    } else if(now - m_FireTime >= 2 * m_Window) {
+      state.timeouts++;
+      state.pending = false;
+    } else {
+      busy = true;
+    }
+  }
+  if(!busy) {
+    m_Current = (m_Current + 1) % m_Groups.size();
+    fire(now);
+  }
+  return count;
+}
+
+void SRF08Scheduler::addUngrouped()
+{
+  std::map<int, bool> grouped;
+  for(std::vector<Group>::const_iterator group=m_Groups.begin(); group!=m_Groups.end(); ++group) {
+    for(std::vector<int>::const_iterator iter=group->angles.begin(); iter!=group->angles.end(); ++iter) {
+      grouped[*iter] = true;
+    }
+  }
+  for(SRF08SensorMap::const_iterator iter=m_Sensors.begin(); iter!=m_Sensors.end(); ++iter) {
+    if(!grouped[iter->first]) {
+      addGroup(std::vector<int>(1, iter->first));
+    }
+  }
+}
+
+/* The window of a group is the ranging time of its slowest sensor */
+void SRF08Scheduler::fire(uint64_t now)
+{
+  const Group& group = m_Groups[m_Current];
+  m_Window = 0;
+  for(std::vector<int>::const_iterator iter=group.angles.begin(); iter!=group.angles.end(); ++iter) {
+    boost::shared_ptr<srf08> sensor = m_Sensors[*iter];
+    m_States[*iter].pending = sensor->initiateRanging();
+    if(sensor->getRangingTime() > m_Window) {
+      m_Window = sensor->getRangingTime();
+    }
+  }
+  m_FireTime = now;
+  m_Fired = true;
+}
+
+/* Achieved samples per second of one sensor since its first sample */
+float SRF08Scheduler::getUpdateRate(int angle)
+{
+  std::map<int, SensorState>::const_iterator iter = m_States.find(angle);
+  if(iter == m_States.end() || iter->second.samples < 2) {
+    return 0;
+  }
+  return (iter->second.samples - 1) * (float)NSEC_PER_SEC / (iter->second.lastSample - iter->second.firstSample);
+}
+
+void SRF08Scheduler::printStatistics(std::ostream& out)
+{
+  out << "SRF08 schedule: " << m_Groups.size() << " groups" << std::endl;
+  for(std::map<int, SensorState>::const_iterator iter=m_States.begin(); iter!=m_States.end(); ++iter) {
+    out << "  " << iter->first << " deg: " << m_Sensors[iter->first]->getMaxRange() << " cm range, "
+        << iter->second.samples << " samples, "
+        << getUpdateRate(iter->first) << " Hz, " << iter->second.timeouts << " timeouts" << std::endl;
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef SRF08_SCHEDULER_H
+#define SRF08_SCHEDULER_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+#include <ostream>
+#include "SRF08.h"
+
+#include <boost/shared_ptr.hpp>
+
+typedef std::map<int, boost::shared_ptr<srf08> > SRF08SensorMap;
+
+/* Fires SRF08s in groups so sensors facing each other never ping at the
+   same time. Groups are fired in turn; a group's sensors are only read
+   once their ranging time has passed, then the next group is fired.
+   Sensors are addressed by mounting angle. */
+class SRF08Scheduler
+{
+ public:
+  struct Reading
+  {
+    int angle;
+    int index; /* of the sensor in getSensors() order */
+    int range;
+    uint64_t time;
+    /* All echoes of the ping, nearest first, as many as the sensor's
+       echo count allows */
+    int echoCount;
+    uint16_t echoes[SRF08_MAX_ECHOES];
+  };
+
+  SRF08Scheduler(const SRF08SensorMap& sensors);
+
+  bool addGroup(const std::vector<int>& angles);
+  const SRF08SensorMap& getSensors();
+
+  int update(uint64_t now, Reading* readings, int maxReadings);
+
+  float getUpdateRate(int angle);
+  void printStatistics(std::ostream& out);
+
+ private:
+  struct Group
+  {
+    std::vector<int> angles;
+    std::vector<int> indices; /* parallel to angles */
+  };
+
+  struct SensorState
+  {
+    bool pending;
+    uint64_t samples;
+    uint64_t timeouts;
+    uint64_t firstSample;
+    uint64_t lastSample;
+  };
+
+  void addUngrouped();
+  void fire(uint64_t now);
+
+  SRF08SensorMap m_Sensors;
+  std::vector<Group> m_Groups;
+  std::map<int, SensorState> m_States;
+  int m_Current;
+  bool m_Fired;
+  uint64_t m_FireTime;
+  uint64_t m_Window;
+};
+#endif
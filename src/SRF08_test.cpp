@@ -25,6 +25,7 @@ int main(int argc, const char** argv)
       return 1;
     }
   }
+  sensor.setEchoCount(SRF08_MAX_ECHOES);
   if(!sensor.initiateRanging()) {
     std::cout << "Ranging failed" << std::endl;
     return 1;
@@ -36,4 +37,10 @@ int main(int argc, const char** argv)
   }
 
   std::cout << "light=" << (int)sensor.getLightLevel() << ", range=" << sensor.getRange() << " cm" << std::endl;
+
+  uint16_t echoes[SRF08_MAX_ECHOES];
+  int count = sensor.getEchoes(echoes, SRF08_MAX_ECHOES);
+  for(int i = 0; i < count; ++i) {
+    std::cout << "echo " << i << ": " << echoes[i] << " cm" << std::endl;
+  }
 }
@@ -0,0 +1,175 @@
+#include "SensorAcquisition.h"
+#include "Timing.h"
+#include "Trace.h"
+
+/* More than enough for the SRF08s finishing in one acquisition period */
+#define MAX_SRF08_READINGS 16
+
+SensorAcquisition::SensorAcquisition(boost::shared_ptr<SRF08Scheduler> ultrasonic, const AnalogSensorMap& analog, int frequency) :
+  m_Ultrasonic(ultrasonic),
+  m_Period(NSEC_PER_SEC / ((frequency > 0) ? frequency : 1)),
+  m_Running(false)
+{
+  const SRF08SensorMap& sensors = m_Ultrasonic->getSensors();
+  for(SRF08SensorMap::const_iterator iter=sensors.begin(); iter!=sensors.end(); ++iter) {
+    m_Slots[iter->first] = m_Angles.size();
+    m_SRF08Slots.push_back(m_Angles.size());
+    m_Angles.push_back(iter->first);
+  }
+  for(AnalogSensorMap::const_iterator iter=analog.begin(); iter!=analog.end(); ++iter) {
+    AnalogSlot entry;
+    entry.sensor = iter->second;
+    entry.slot = m_Angles.size();
+    m_Slots[iter->first] = m_Angles.size();
+    m_Analog.push_back(entry);
+    m_Angles.push_back(iter->first);
+  }
+  m_Samples.resize(m_Angles.size());
+  m_Sequences.resize(m_Angles.size(), 0);
+}
+
+SensorAcquisition::~SensorAcquisition()
+{
+  stop();
+}
+
+bool SensorAcquisition::start()
+{
+  if(m_Running) {
+    return false;
+  }
+  m_Running = true;
+  if(pthread_create(&m_Thread, NULL, &SensorAcquisition::threadMain, this) != 0) {
+    m_Running = false;
+    return false;
+  }
+  return true;
+}
+
+void SensorAcquisition::stop()
+{
+  if(m_Running) {
+    m_Running = false;
+    pthread_join(m_Thread, NULL);
+  }
+}
+
+int SensorAcquisition::getSlotCount()
+{
+  return m_Angles.size();
+}
+
+int SensorAcquisition::getSlot(int angle)
+{
+  std::map<int, int>::const_iterator iter = m_Slots.find(angle);
+  return (iter == m_Slots.end()) ? -1 : iter->second;
+}
+
+int SensorAcquisition::getAngle(int slot)
+{
+  return m_Angles.at(slot);
+}
+
+SensorAcquisition::Sample SensorAcquisition::getSample(int slot)
+{
+  return m_Samples[slot].read();
+}
+
+/* Next analog sensor after iter that has to be triggered by the caller,
+   wrapping around. Sensors fed by an ADC scanner are skipped. */
+AnalogSensorMap::const_iterator SensorAcquisition::nextPolledAnalogSensor(const AnalogSensorMap& sensors, AnalogSensorMap::const_iterator iter)
+{
+  for(size_t i = 0; i < sensors.size(); ++i) {
+    if(iter == sensors.end() || ++iter == sensors.end()) {
+      iter = sensors.begin();
+    }
+    if(!iter->second->isScanned()) {
+      return iter;
+    }
+  }
+  return sensors.end();
+}
+
+/* nextPolledAnalogSensor() over the slot list, -1 for none */
+int SensorAcquisition::nextPolledAnalog(int index)
+{
+  for(size_t i = 0; i < m_Analog.size(); ++i) {
+    if(index < 0 || ++index == (int)m_Analog.size()) {
+      index = 0;
+    }
+    if(!m_Analog[index].sensor->isScanned()) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+void* SensorAcquisition::threadMain(void* arg)
+{
+  static_cast<SensorAcquisition*>(arg)->acquire();
+  return NULL;
+}
+
+void SensorAcquisition::acquire()
+{
+  int polled = -1;
+  uint64_t deadline = monotonicNs();
+
+  while(m_Running) {
+    TraceScope trace(TRACE_ACQUIRE);
+    SRF08Scheduler::Reading readings[MAX_SRF08_READINGS];
+    int count = m_Ultrasonic->update(monotonicNs(), readings, MAX_SRF08_READINGS);
+    for(int i = 0; i < count; ++i) {
+      publish(m_SRF08Slots[readings[i].index], readings[i].range, readings[i].time, readings[i].echoes, readings[i].echoCount);
+    }
+
+    for(size_t i = 0; i < m_Analog.size(); ++i) {
+      const AnalogSlot& analog = m_Analog[i];
+      if(analog.sensor->isScanned() && analog.sensor->rangingComplete()) {
+        int range = analog.sensor->getRange();
+        publish(analog.slot, range, timespecToNs(analog.sensor->getSampleTime()));
+      }
+    }
+
+    if(polled < 0) {
+      polled = nextPolledAnalog(polled);
+      if(polled >= 0) {
+        m_Analog[polled].sensor->initiateRanging();
+      }
+    } else if(m_Analog[polled].sensor->rangingComplete()) {
+      const AnalogSlot& analog = m_Analog[polled];
+      int range = analog.sensor->getRange();
+      publish(analog.slot, range, timespecToNs(analog.sensor->getSampleTime()));
+      polled = nextPolledAnalog(polled);
+      m_Analog[polled].sensor->initiateRanging();
+    }
+
+    trace.stop();
+
+    /* Fixed rate, but never try to catch up on missed slots */
+    deadline += m_Period;
+    uint64_t now = monotonicNs();
+    if(deadline < now) {
+      deadline = now;
+    }
+    sleepUntilNs(deadline);
+  }
+}
+
+void SensorAcquisition::printStatistics(std::ostream& out)
+{
+  m_Ultrasonic->printStatistics(out);
+}
+
+void SensorAcquisition::publish(int slot, int range, uint64_t time, const uint16_t* echoes, int echoCount)
+{
+  Sample sample;
+  sample.range = range;
+  sample.time = time;
+  sample.sequence = ++m_Sequences[slot];
+  sample.echoCount = echoCount;
+  for(int i = 0; i < echoCount; ++i) {
+    sample.echoes[i] = echoes[i];
+  }
+  m_Samples[slot].write(sample);
+}
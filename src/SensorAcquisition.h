@@ -0,0 +1,73 @@
+#ifndef SENSOR_ACQUISITION_H
+#define SENSOR_ACQUISITION_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <map>
+#include <vector>
+#include "SRF08Scheduler.h"
+#include "AnalogDistanceSensor.h"
+#include "SeqLock.h"
+
+#include <boost/shared_ptr.hpp>
+
+typedef std::map<int, boost::shared_ptr<AnalogDistanceSensor> > AnalogSensorMap;
+
+/* Polls all distance sensors in a thread of its own and publishes the
+   latest range of every sensor through a sequence lock, so the decision
+   thread never waits for an I2C transfer. SRF08s are fired by an
+   SRF08Scheduler. Sensors are addressed by slot,
+   resolved once from their mounting angle. */
+class SensorAcquisition
+{
+ public:
+  struct Sample
+  {
+    int range;
+    uint64_t time;
+    uint32_t sequence;
+    /* Every echo of an SRF08 ping, nearest first, none for other sensors */
+    int echoCount;
+    uint16_t echoes[SRF08_MAX_ECHOES];
+  };
+
+  SensorAcquisition(boost::shared_ptr<SRF08Scheduler> ultrasonic, const AnalogSensorMap& analog, int frequency);
+  ~SensorAcquisition();
+
+  bool start();
+  void stop();
+
+  int getSlotCount();
+  int getSlot(int angle);
+  int getAngle(int slot);
+  Sample getSample(int slot);
+
+  void printStatistics(std::ostream& out);
+
+  static AnalogSensorMap::const_iterator nextPolledAnalogSensor(const AnalogSensorMap& sensors, AnalogSensorMap::const_iterator iter);
+
+ private:
+  struct AnalogSlot
+  {
+    boost::shared_ptr<AnalogDistanceSensor> sensor;
+    int slot;
+  };
+
+  static void* threadMain(void* arg);
+  void acquire();
+  int nextPolledAnalog(int index);
+  void publish(int slot, int range, uint64_t time, const uint16_t* echoes = NULL, int echoCount = 0);
+
+  boost::shared_ptr<SRF08Scheduler> m_Ultrasonic;
+  std::vector<AnalogSlot> m_Analog;
+  std::vector<int> m_SRF08Slots; /* parallel to the scheduler's sensors */
+  std::map<int, int> m_Slots;
+  std::vector<int> m_Angles;
+  std::vector<SeqLock<Sample> > m_Samples;
+  std::vector<uint32_t> m_Sequences;
+  uint64_t m_Period;
+
+  pthread_t m_Thread;
+  volatile bool m_Running;
+};
+#endif
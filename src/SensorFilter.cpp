@@ -0,0 +1,133 @@
+#include "SensorFilter.h"
+
+SensorFilter::SensorFilter() : m_StageCount(0), m_Value(0), m_Variance(0)
+{
+}
+
+bool SensorFilter::addStage(const Stage& stage)
+{
+  if(m_StageCount >= SENSOR_FILTER_MAX_STAGES) {
+    return false;
+  }
+  m_Stages[m_StageCount] = stage;
+  m_Stages[m_StageCount].state = 0;
+  m_Stages[m_StageCount].primed = false;
+  m_StageCount++;
+  return true;
+}
+
+/* Median of the last window readings, window at most SENSOR_HISTORY_DEPTH */
+bool SensorFilter::addMedian(int window)
+{
+  if(window < 1 || window > SENSOR_HISTORY_DEPTH || m_StageCount > 0) {
+    return false;
+  }
+  Stage stage;
+  stage.type = STAGE_MEDIAN;
+  stage.window = window;
+  return addStage(stage);
+}
+
+/* Exponential moving average, alpha is the weight of the newest input */
+bool SensorFilter::addEma(float alpha)
+{
+  if(alpha <= 0 || alpha > 1) {
+    return false;
+  }
+  Stage stage;
+  stage.type = STAGE_EMA;
+  stage.alpha = alpha;
+  return addStage(stage);
+}
+
+/* Limit to the range the sensor can actually measure */
+bool SensorFilter::addClamp(int min, int max)
+{
+  if(min > max) {
+    return false;
+  }
+  Stage stage;
+  stage.type = STAGE_CLAMP;
+  stage.min = min;
+  stage.max = max;
+  return addStage(stage);
+}
+
+/* readings has just had the new reading pushed */
+void SensorFilter::update(const SensorHistory& readings)
+{
+  float value = readings.back();
+  for(int i = 0; i < m_StageCount; ++i) {
+    Stage& stage = m_Stages[i];
+    switch(stage.type) {
+    case STAGE_MEDIAN:
+      value = median(readings, stage.window);
+      break;
+    case STAGE_EMA:
+      if(!stage.primed) {
+        stage.state = value;
+        stage.primed = true;
+      } else {
+        stage.state += stage.alpha * (value - stage.state);
+      }
+      value = stage.state;
+      break;
+    case STAGE_CLAMP:
+      if(value < stage.min) {
+        value = stage.min;
+      } else if(value > stage.max) {
+        value = stage.max;
+      }
+      break;
+    }
+  }
+
+  m_Value = value;
+  m_Outputs.push(getValue(), readings.at(0).time);
+
+  float mean = 0;
+  for(int i = 0; i < m_Outputs.size(); ++i) {
+    mean += m_Outputs.at(i).range;
+  }
+  mean /= m_Outputs.size();
+  float sum = 0;
+  for(int i = 0; i < m_Outputs.size(); ++i) {
+    sum += (m_Outputs.at(i).range - mean) * (m_Outputs.at(i).range - mean);
+  }
+  m_Variance = sum / m_Outputs.size();
+}
+
+bool SensorFilter::empty() const
+{
+  return m_Outputs.empty();
+}
+
+int SensorFilter::getValue() const
+{
+  return (int)(m_Value + 0.5f);
+}
+
+/* Variance of the filtered value over the last SENSOR_HISTORY_DEPTH updates */
+float SensorFilter::getVariance() const
+{
+  return m_Variance;
+}
+
+float SensorFilter::median(const SensorHistory& readings, int window)
+{
+  int count = (readings.size() < window) ? readings.size() : window;
+  int sorted[SENSOR_HISTORY_DEPTH];
+  for(int i = 0; i < count; ++i) {
+    int value = readings.at(i).range;
+    int j = i;
+    while(j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = value;
+  }
+  if(count % 2) {
+    return sorted[count / 2];
+  }
+  return (sorted[count / 2 - 1] + sorted[count / 2]) / 2.0f;
+}
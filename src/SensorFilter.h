@@ -0,0 +1,56 @@
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+#include "SensorHistory.h"
+
+#define SENSOR_FILTER_MAX_STAGES 4
+
+/* Chain of filter stages applied to each new reading of one sensor.
+   Stages run in the order they were added; each sees the output of the
+   one before. A median works on the raw readings of the sensor's
+   SensorHistory, so it can only be the first stage. The outputs are kept
+   in a SensorHistory of their own for the variance. Updates do not
+   allocate. */
+class SensorFilter
+{
+ public:
+  SensorFilter();
+
+  bool addMedian(int window);
+  bool addEma(float alpha);
+  bool addClamp(int min, int max);
+
+  void update(const SensorHistory& readings);
+
+  bool empty() const;
+  int getValue() const;
+  float getVariance() const;
+
+ private:
+  enum StageType {
+    STAGE_MEDIAN,
+    STAGE_EMA,
+    STAGE_CLAMP
+  };
+
+  struct Stage
+  {
+    StageType type;
+    int window;
+    float alpha;
+    int min;
+    int max;
+    float state;
+    bool primed;
+  };
+
+  bool addStage(const Stage& stage);
+  static float median(const SensorHistory& readings, int window);
+
+  Stage m_Stages[SENSOR_FILTER_MAX_STAGES];
+  int m_StageCount;
+  SensorHistory m_Outputs;
+  float m_Value;
+  float m_Variance;
+};
+#endif
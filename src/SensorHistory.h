@@ -0,0 +1,59 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <stdint.h>
+
+#define SENSOR_HISTORY_DEPTH 10
+
+/* Fixed-capacity ring of the most recent timestamped readings of one sensor.
+   Storage is inline so a table of these is a single contiguous allocation. */
+class SensorHistory
+{
+ public:
+  struct Sample
+  {
+    int range;
+    uint64_t time;
+  };
+
+  SensorHistory() : m_Next(0), m_Count(0)
+  {
+  }
+
+  void push(int range, uint64_t time)
+  {
+    m_Samples[m_Next].range = range;
+    m_Samples[m_Next].time = time;
+    m_Next = (m_Next + 1) % SENSOR_HISTORY_DEPTH;
+    if(m_Count < SENSOR_HISTORY_DEPTH) {
+      m_Count++;
+    }
+  }
+
+  bool empty() const
+  {
+    return m_Count == 0;
+  }
+
+  int size() const
+  {
+    return m_Count;
+  }
+
+  /* age 0 is the newest sample, size()-1 the oldest */
+  const Sample& at(int age) const
+  {
+    return m_Samples[(m_Next + SENSOR_HISTORY_DEPTH - 1 - age) % SENSOR_HISTORY_DEPTH];
+  }
+
+  int back() const
+  {
+    return at(0).range;
+  }
+
+ private:
+  Sample m_Samples[SENSOR_HISTORY_DEPTH];
+  int m_Next;
+  int m_Count;
+};
+#endif
@@ -0,0 +1,45 @@
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* Single-writer sequence lock for small plain structs. The writer never
+   blocks; readers retry only while a write is in flight, which for the
+   few bytes of a sensor sample is a handful of nanoseconds. */
+template<typename T>
+class SeqLock
+{
+ public:
+  SeqLock() : m_Sequence(0)
+  {
+    memset(&m_Value, 0, sizeof(m_Value));
+  }
+
+  void write(const T& value)
+  {
+    uint32_t sequence = __atomic_load_n(&m_Sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&m_Sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&m_Value, &value, sizeof(T));
+    __atomic_store_n(&m_Sequence, sequence + 2, __ATOMIC_RELEASE);
+  }
+
+  T read() const
+  {
+    T value;
+    uint32_t before, after;
+    do {
+      before = __atomic_load_n(&m_Sequence, __ATOMIC_ACQUIRE);
+      memcpy(&value, &m_Value, sizeof(T));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      after = __atomic_load_n(&m_Sequence, __ATOMIC_RELAXED);
+    } while((before & 1) || before != after);
+    return value;
+  }
+
+ private:
+  uint32_t m_Sequence;
+  T m_Value;
+};
+#endif
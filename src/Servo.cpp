@@ -1,10 +1,12 @@
 #include "Servo.h"
 #include <algorithm>
+#include <cstdlib>
 #include <iostream>
 
 Servo::Servo(boost::shared_ptr<Adafruit_PWMServoDriver> pwm, uint8_t channel, uint16_t maxLeft, uint16_t maxRight) :
   m_PWM(pwm),
-  m_Channel(channel)
+  m_Channel(channel),
+  m_Deadband(0)
 {
   if(maxLeft < maxRight) {
     m_Min = maxLeft;
@@ -22,6 +24,26 @@ void Servo::setDirection(int direction)
   if(m_InvertDirection) {
     direction = -direction;
   }
-  uint16_t value = std::max<uint16_t>(m_Min, std::min<uint16_t>(m_Max, (((double)(m_Min + m_Max))/2000.0)*(direction+1000)));
+  int value = std::max<int>(m_Min, std::min<int>(m_Max, ((int)(m_Min + m_Max) * (direction + 1000)) / 2000));
+  /* Small moves away from what the chip holds are dropped, but the end points
+     and the center are always reached. Unchanged values are left to the driver,
+     which also resends them after a failed write. */
+  int committed = m_PWM->getCommittedPin(m_Channel);
+  int change = std::abs(value - committed);
+  if(committed >= 0 && change > 0 && change <= m_Deadband &&
+     value != m_Min && value != m_Max && value != (m_Min + m_Max) / 2) {
+    return;
+  }
   m_PWM->setPin(m_Channel, value, false);
 }
+
+/* Changes of at most this many ticks are not written */
+void Servo::setDeadband(uint16_t ticks)
+{
+  m_Deadband = ticks;
+}
+
+void Servo::flush()
+{
+  m_PWM->flush();
+}
@@ -12,6 +12,8 @@ class Servo
   Servo(boost::shared_ptr<Adafruit_PWMServoDriver> pwm, uint8_t channel, uint16_t maxLeft, uint16_t maxRight);
 
   void setDirection(int direction);
+  void setDeadband(uint16_t ticks);
+  void flush();
 
  private:
   boost::shared_ptr<Adafruit_PWMServoDriver> m_PWM;
@@ -19,5 +21,6 @@ class Servo
   uint16_t m_Min;
   uint16_t m_Max;
   bool m_InvertDirection;
+  uint16_t m_Deadband;
 };
 #endif
@@ -0,0 +1,104 @@
+#include "SpeedFusion.h"
+
+#include <math.h>
+
+/* Below this (mm^2) the sensors are taken to be in one spot */
+#define SPEED_FUSION_MIN_SPREAD 1.0
+
+SpeedFusion::SpeedFusion() :
+  m_CenterX(0),
+  m_CenterY(0),
+  m_Spread(0)
+{
+}
+
+void SpeedFusion::addSensor(boost::shared_ptr<MouseSpeedSensor> sensor, double x, double y, double angle)
+{
+  Mount mount;
+  mount.x = x;
+  mount.y = y;
+  mount.cos = cos(angle * M_PI / 180.0);
+  mount.sin = sin(angle * M_PI / 180.0);
+  m_Sensors.push_back(sensor);
+  m_Mounts.push_back(mount);
+  m_Speeds.resize(m_Sensors.size());
+  m_VelocityX.resize(m_Sensors.size());
+  m_VelocityY.resize(m_Sensors.size());
+
+  /* The fit only depends on the geometry through these */
+  m_CenterX = m_CenterY = 0;
+  for(size_t i = 0; i < m_Mounts.size(); ++i) {
+    m_CenterX += m_Mounts[i].x / m_Mounts.size();
+    m_CenterY += m_Mounts[i].y / m_Mounts.size();
+  }
+  m_Spread = 0;
+  for(size_t i = 0; i < m_Mounts.size(); ++i) {
+    m_Spread += (m_Mounts[i].x - m_CenterX) * (m_Mounts[i].x - m_CenterX) + (m_Mounts[i].y - m_CenterY) * (m_Mounts[i].y - m_CenterY);
+  }
+}
+
+int SpeedFusion::getSensorCount()
+{
+  return m_Sensors.size();
+}
+
+bool SpeedFusion::start()
+{
+  for(size_t i = 0; i < m_Sensors.size(); ++i) {
+    if(!m_Sensors[i]->start()) {
+      stop();
+      return false;
+    }
+  }
+  return true;
+}
+
+void SpeedFusion::stop()
+{
+  for(size_t i = 0; i < m_Sensors.size(); ++i) {
+    m_Sensors[i]->stop();
+  }
+}
+
+SpeedFusion::Motion SpeedFusion::getMotion()
+{
+  for(size_t i = 0; i < m_Sensors.size(); ++i) {
+    m_Speeds[i] = m_Sensors[i]->getSpeed();
+  }
+  return fuse(m_Speeds.empty() ? NULL : &m_Speeds[0]);
+}
+
+/* Sensor i measures vx - w*y_i and vy + w*x_i in car coordinates.
+   Relative to the centroid of the sensors the velocity and the yaw rate
+   separate, so the 3x3 normal equations solve in closed form. */
+SpeedFusion::Motion SpeedFusion::fuse(const MouseSpeedSensor::MouseSpeed* speeds)
+{
+  Motion motion = {0, 0, 0};
+  if(m_Mounts.empty()) {
+    return motion;
+  }
+  std::vector<double>& vx = m_VelocityX;
+  std::vector<double>& vy = m_VelocityY;
+  double meanX = 0;
+  double meanY = 0;
+  for(size_t i = 0; i < m_Mounts.size(); ++i) {
+    /* Sensor frame: forward motion gives negative y, x goes to the right */
+    double forward = -speeds[i].y;
+    double left = -speeds[i].x;
+    vx[i] = forward * m_Mounts[i].cos - left * m_Mounts[i].sin;
+    vy[i] = forward * m_Mounts[i].sin + left * m_Mounts[i].cos;
+    meanX += vx[i] / m_Mounts.size();
+    meanY += vy[i] / m_Mounts.size();
+  }
+  double yawRate = 0;
+  if(m_Spread > SPEED_FUSION_MIN_SPREAD) {
+    for(size_t i = 0; i < m_Mounts.size(); ++i) {
+      yawRate += (m_Mounts[i].x - m_CenterX) * (vy[i] - meanY) - (m_Mounts[i].y - m_CenterY) * (vx[i] - meanX);
+    }
+    yawRate /= m_Spread;
+  }
+  motion.forward = lrint(meanX + yawRate * m_CenterY);
+  motion.lateral = lrint(meanY - yawRate * m_CenterX);
+  motion.yawRate = lrint(yawRate * 1000);
+  return motion;
+}
@@ -0,0 +1,57 @@
+#ifndef SPEED_FUSION_H
+#define SPEED_FUSION_H
+
+#include <stdint.h>
+#include <vector>
+#include "MouseSpeedSensor.h"
+
+#include <boost/shared_ptr.hpp>
+
+/* Combines any number of optical speed sensors into the motion of the
+   car. Mounting positions are in mm with x forward and y to the left of
+   the reference point, the angle turns the sensor counter-clockwise.
+   Every sensor sees the car velocity plus the yaw rate times its lever
+   arm, the least squares fit of that gives forward and lateral velocity
+   at the reference point and the yaw rate. With all sensors in one spot
+   the yaw rate cannot be told apart and is taken as 0. */
+class SpeedFusion
+{
+ public:
+  struct Motion
+  {
+    int forward;  /* mm/s */
+    int lateral;  /* mm/s, to the left */
+    int yawRate;  /* mrad/s, counter-clockwise */
+  };
+
+  SpeedFusion();
+
+  void addSensor(boost::shared_ptr<MouseSpeedSensor> sensor, double x, double y, double angle);
+  int getSensorCount();
+
+  bool start();
+  void stop();
+
+  Motion getMotion();
+  Motion fuse(const MouseSpeedSensor::MouseSpeed* speeds);
+
+ private:
+  struct Mount
+  {
+    double x;
+    double y;
+    double cos;
+    double sin;
+  };
+
+  std::vector<boost::shared_ptr<MouseSpeedSensor> > m_Sensors;
+  std::vector<Mount> m_Mounts;
+  /* Per sensor scratch of getMotion()/fuse(), sized in addSensor() */
+  std::vector<MouseSpeedSensor::MouseSpeed> m_Speeds;
+  std::vector<double> m_VelocityX;
+  std::vector<double> m_VelocityY;
+  double m_CenterX;
+  double m_CenterY;
+  double m_Spread;
+};
+#endif
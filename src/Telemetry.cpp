@@ -0,0 +1,213 @@
+#include "Telemetry.h"
+#include "Timing.h"
+
+#include <iostream>
+#include <fstream>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* The file is extended and remapped this much at a time */
+#define TELEMETRY_CHUNK (1024 * 1024)
+#define TELEMETRY_FLUSH_PERIOD (10 * NSEC_PER_MSEC)
+#define TELEMETRY_SYNC_PERIOD NSEC_PER_SEC
+
+TelemetryLog::TelemetryLog() :
+  m_Slots(NULL),
+  m_Mask(0),
+  m_Head(0),
+  m_Tail(0),
+  m_Dropped(0),
+  m_Fd(-1),
+  m_Map(NULL),
+  m_MapSize(0),
+  m_Used(0),
+  m_Running(false)
+{
+}
+
+TelemetryLog::~TelemetryLog()
+{
+  close();
+}
+
+/* Create the log file and start the flush thread. The ring holds
+   2^capacityLog2 records not yet written to the file. */
+bool TelemetryLog::open(const char* path, int capacityLog2)
+{
+  if(m_Fd != -1 || capacityLog2 < 1 || capacityLog2 > 24) {
+    return false;
+  }
+  m_Fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if(m_Fd == -1) {
+    return false;
+  }
+  if(!grow()) {
+    ::close(m_Fd);
+    m_Fd = -1;
+    return false;
+  }
+
+  TelemetryHeader header;
+  memcpy(header.magic, TELEMETRY_MAGIC, sizeof(header.magic));
+  header.version = TELEMETRY_VERSION;
+  header.recordSize = sizeof(TelemetryRecord);
+  header.startTime = monotonicNs();
+  memcpy(m_Map, &header, sizeof(header));
+  m_Used = sizeof(header);
+
+  uint64_t capacity = 1ULL << capacityLog2;
+  m_Slots = new Slot[capacity];
+  for(uint64_t i = 0; i < capacity; ++i) {
+    m_Slots[i].sequence = 0;
+  }
+  m_Mask = capacity - 1;
+  m_Head = 0;
+  m_Tail = 0;
+  m_Dropped = 0;
+
+  m_Running = true;
+  if(pthread_create(&m_Thread, NULL, &TelemetryLog::threadMain, this) != 0) {
+    m_Running = false;
+    close();
+    return false;
+  }
+  return true;
+}
+
+/* Write out whatever is left in the ring and cut the file to its content */
+void TelemetryLog::close()
+{
+  if(m_Running) {
+    m_Running = false;
+    pthread_join(m_Thread, NULL);
+  }
+  if(m_Map) {
+    drain();
+    msync(m_Map, m_Used, MS_SYNC);
+    munmap(m_Map, m_MapSize);
+    m_Map = NULL;
+  }
+  if(m_Fd != -1) {
+    if(ftruncate(m_Fd, m_Used) != 0) {
+      std::cout << "Failed to truncate telemetry log" << std::endl;
+    }
+    ::close(m_Fd);
+    m_Fd = -1;
+  }
+  delete[] m_Slots;
+  m_Slots = NULL;
+}
+
+void TelemetryLog::log(uint64_t time, TelemetryType type, int id, int32_t a, int32_t b, int32_t c)
+{
+  if(!m_Slots) {
+    return;
+  }
+  uint64_t head = __atomic_load_n(&m_Head, __ATOMIC_RELAXED);
+  do {
+    if(head - __atomic_load_n(&m_Tail, __ATOMIC_ACQUIRE) > m_Mask) {
+      __atomic_fetch_add(&m_Dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  } while(!__atomic_compare_exchange_n(&m_Head, &head, head + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+  Slot& slot = m_Slots[head & m_Mask];
+  slot.record.time = time;
+  slot.record.type = type;
+  slot.record.id = id;
+  slot.record.values[0] = a;
+  slot.record.values[1] = b;
+  slot.record.values[2] = c;
+  __atomic_store_n(&slot.sequence, head + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t TelemetryLog::getRecords()
+{
+  return (m_Used > sizeof(TelemetryHeader)) ? (m_Used - sizeof(TelemetryHeader)) / sizeof(TelemetryRecord) : 0;
+}
+
+uint64_t TelemetryLog::getDropped()
+{
+  return __atomic_load_n(&m_Dropped, __ATOMIC_RELAXED);
+}
+
+/* Load all records of a log written by TelemetryLog */
+bool TelemetryLog::read(const char* path, std::vector<TelemetryRecord>& records)
+{
+  std::ifstream in(path, std::ios::binary);
+  TelemetryHeader header;
+  if(!in.read((char*)&header, sizeof(header)) ||
+     memcmp(header.magic, TELEMETRY_MAGIC, sizeof(header.magic)) != 0 ||
+     header.version != TELEMETRY_VERSION || header.recordSize != sizeof(TelemetryRecord)) {
+    return false;
+  }
+  TelemetryRecord record;
+  while(in.read((char*)&record, sizeof(record))) {
+    records.push_back(record);
+  }
+  return true;
+}
+
+void* TelemetryLog::threadMain(void* arg)
+{
+  static_cast<TelemetryLog*>(arg)->flushLoop();
+  return NULL;
+}
+
+void TelemetryLog::flushLoop()
+{
+  uint64_t lastSync = monotonicNs();
+  while(m_Running) {
+    if(!drain()) {
+      break;
+    }
+    uint64_t now = monotonicNs();
+    if(now - lastSync >= TELEMETRY_SYNC_PERIOD) {
+      msync(m_Map, m_Used, MS_ASYNC);
+      lastSync = now;
+    }
+    sleepUntilNs(now + TELEMETRY_FLUSH_PERIOD);
+  }
+}
+
+/* Copy the committed records in order from the ring into the mapping */
+bool TelemetryLog::drain()
+{
+  uint64_t tail = m_Tail;
+  for(;;) {
+    Slot& slot = m_Slots[tail & m_Mask];
+    if(__atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE) != tail + 1) {
+      break;
+    }
+    if(m_Used + sizeof(TelemetryRecord) > m_MapSize && !grow()) {
+      return false;
+    }
+    memcpy(m_Map + m_Used, &slot.record, sizeof(TelemetryRecord));
+    m_Used += sizeof(TelemetryRecord);
+    tail++;
+    __atomic_store_n(&m_Tail, tail, __ATOMIC_RELEASE);
+  }
+  return true;
+}
+
+bool TelemetryLog::grow()
+{
+  uint64_t size = m_MapSize + TELEMETRY_CHUNK;
+  if(ftruncate(m_Fd, size) != 0) {
+    return false;
+  }
+  void* map;
+  if(m_Map) {
+    map = mremap(m_Map, m_MapSize, size, MREMAP_MAYMOVE);
+  } else {
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_Fd, 0);
+  }
+  if(map == MAP_FAILED) {
+    return false;
+  }
+  m_Map = (uint8_t*)map;
+  m_MapSize = size;
+  return true;
+}
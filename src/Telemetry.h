@@ -0,0 +1,84 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+
+#define TELEMETRY_MAGIC "RCTL"
+#define TELEMETRY_VERSION 2
+
+enum TelemetryType {
+  TELEMETRY_RANGE = 1,    /* id: angle, raw range, filtered range, variance (cm) */
+  TELEMETRY_MOUSE = 2,    /* fused forward, lateral mm/s, yaw mrad/s, as the controller read it */
+  TELEMETRY_MOTOR = 3,    /* commanded speed */
+  TELEMETRY_STEERING = 4, /* commanded direction */
+  TELEMETRY_DECISION = 5, /* id: Controller::Reason bits; forward, turn multiplier, direction, once per cycle */
+  TELEMETRY_MOUSE_PACKET = 6, /* id: mouse; dx, dy counts, at the kernel or receive time of the packet */
+  TELEMETRY_ECHO = 7      /* id: angle; echo number from 1, range (cm), for the echoes behind the first */
+};
+
+/* On disk every record has this fixed layout, after one TelemetryHeader */
+struct TelemetryRecord
+{
+  uint64_t time;
+  uint16_t type;
+  int16_t id;
+  int32_t values[3];
+};
+
+struct TelemetryHeader
+{
+  char magic[4];
+  uint16_t version;
+  uint16_t recordSize;
+  uint64_t startTime;
+};
+
+/* Append-only binary log. log() only copies the record into a preallocated
+   ring and never blocks; a background thread moves records from the ring
+   into a memory-mapped file that grows in chunks. Records that do not fit
+   into a full ring are dropped and counted. */
+class TelemetryLog
+{
+ public:
+  TelemetryLog();
+  ~TelemetryLog();
+
+  bool open(const char* path, int capacityLog2);
+  void close();
+
+  void log(uint64_t time, TelemetryType type, int id, int32_t a = 0, int32_t b = 0, int32_t c = 0);
+
+  uint64_t getRecords();
+  uint64_t getDropped();
+
+  static bool read(const char* path, std::vector<TelemetryRecord>& records);
+
+ private:
+  struct Slot
+  {
+    uint64_t sequence;
+    TelemetryRecord record;
+  };
+
+  static void* threadMain(void* arg);
+  void flushLoop();
+  bool drain();
+  bool grow();
+
+  Slot* m_Slots;
+  uint64_t m_Mask;
+  uint64_t m_Head;
+  uint64_t m_Tail;
+  uint64_t m_Dropped;
+
+  int m_Fd;
+  uint8_t* m_Map;
+  uint64_t m_MapSize;
+  uint64_t m_Used;
+
+  pthread_t m_Thread;
+  volatile bool m_Running;
+};
+#endif
@@ -0,0 +1,41 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_USEC 1000ULL
+
+inline uint64_t timespecToNs(const struct timespec& spec)
+{
+  return (uint64_t)spec.tv_sec * NSEC_PER_SEC + spec.tv_nsec;
+}
+
+inline struct timespec nsToTimespec(uint64_t ns)
+{
+  struct timespec spec;
+  spec.tv_sec = ns / NSEC_PER_SEC;
+  spec.tv_nsec = ns % NSEC_PER_SEC;
+  return spec;
+}
+
+/* CLOCK_MONOTONIC in nanoseconds */
+inline uint64_t monotonicNs()
+{
+  struct timespec spec;
+  clock_gettime(CLOCK_MONOTONIC, &spec);
+  return timespecToNs(spec);
+}
+
+/* Sleep until an absolute CLOCK_MONOTONIC time, restarting after signals.
+   Any other error returns at once. */
+inline void sleepUntilNs(uint64_t deadline)
+{
+  struct timespec spec = nsToTimespec(deadline);
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec, NULL) == EINTR) {
+  }
+}
+#endif
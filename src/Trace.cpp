@@ -0,0 +1,101 @@
+#include "Trace.h"
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <fstream>
+#include <iomanip>
+
+static const char* s_EventNames[TRACE_EVENT_COUNT] = {
+  "sense",
+  "decide",
+  "actuate",
+  "motor",
+  "steering",
+  "sleep",
+  "acquire",
+  "i2c read",
+  "i2c write"
+};
+
+static __thread uint32_t s_ThreadId = 0;
+
+TraceRecord* Trace::s_Records = 0;
+uint64_t Trace::s_Mask = 0;
+uint64_t Trace::s_Next = 0;
+
+/* Allocate room for 2^capacityLog2 records. Call before any thread that
+   traces is started. */
+bool Trace::initialize(int capacityLog2)
+{
+  if(s_Records || capacityLog2 < 1 || capacityLog2 > 24) {
+    return false;
+  }
+  uint64_t capacity = 1ULL << capacityLog2;
+  TraceRecord* records = new TraceRecord[capacity];
+  for(uint64_t i = 0; i < capacity; ++i) {
+    records[i].sequence = 0;
+  }
+  s_Mask = capacity - 1;
+  s_Records = records;
+  return true;
+}
+
+void Trace::record(TraceEvent event, uint16_t address, uint64_t start, uint64_t end)
+{
+  if(!s_Records) {
+    return;
+  }
+  if(!s_ThreadId) {
+    s_ThreadId = syscall(SYS_gettid);
+  }
+  uint64_t index = __atomic_fetch_add(&s_Next, 1, __ATOMIC_RELAXED);
+  TraceRecord& record = s_Records[index & s_Mask];
+  /* Mark the slot as being written, the dump skips it until it is done */
+  __atomic_store_n(&record.sequence, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  record.time = start;
+  record.duration = end - start;
+  record.event = event;
+  record.address = address;
+  record.thread = s_ThreadId;
+  __atomic_store_n(&record.sequence, index + 1, __ATOMIC_RELEASE);
+}
+
+/* Write the records still in the ring as Chrome trace event JSON, to be
+   loaded in chrome://tracing or Perfetto */
+bool Trace::writeChromeTrace(const char* path)
+{
+  if(!s_Records) {
+    return false;
+  }
+  std::ofstream out(path);
+  if(!out) {
+    return false;
+  }
+  uint64_t next = __atomic_load_n(&s_Next, __ATOMIC_ACQUIRE);
+  uint64_t first = (next > s_Mask + 1) ? next - (s_Mask + 1) : 0;
+  bool separator = false;
+
+  out << "{\"traceEvents\":[" << std::endl;
+  out << std::fixed << std::setprecision(3);
+  for(uint64_t index = first; index < next; ++index) {
+    const TraceRecord& record = s_Records[index & s_Mask];
+    if(__atomic_load_n(&record.sequence, __ATOMIC_ACQUIRE) != index + 1) {
+      continue;
+    }
+    if(separator) {
+      out << "," << std::endl;
+    }
+    out << "{\"name\":\"" << s_EventNames[record.event] << "\",\"ph\":\"X\",\"pid\":1"
+        << ",\"tid\":" << record.thread
+        << ",\"ts\":" << record.time / 1000.0
+        << ",\"dur\":" << record.duration / 1000.0;
+    if(record.address) {
+      out << ",\"args\":{\"address\":\"0x" << std::hex << record.address << std::dec << "\"}";
+    }
+    out << "}";
+    separator = true;
+  }
+  out << std::endl << "]}" << std::endl;
+  return true;
+}
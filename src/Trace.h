@@ -0,0 +1,81 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "Timing.h"
+
+enum TraceEvent {
+  TRACE_SENSE,
+  TRACE_DECIDE,
+  TRACE_ACTUATE,
+  TRACE_MOTOR,
+  TRACE_STEERING,
+  TRACE_SLEEP,
+  TRACE_ACQUIRE,
+  TRACE_I2C_READ,
+  TRACE_I2C_WRITE,
+  TRACE_EVENT_COUNT
+};
+
+struct TraceRecord
+{
+  uint64_t sequence;
+  uint64_t time;
+  uint32_t duration;
+  uint16_t event;
+  uint16_t address;
+  uint32_t thread;
+};
+
+/* Process wide ring of fixed-size trace records. Writers claim a slot with
+   one atomic increment and never block; once the ring is full the oldest
+   records are overwritten. Nothing is recorded until initialize(). */
+class Trace
+{
+ public:
+  static bool initialize(int capacityLog2);
+  static bool enabled()
+  {
+    return s_Records != 0;
+  }
+
+  static void record(TraceEvent event, uint16_t address, uint64_t start, uint64_t end);
+  static bool writeChromeTrace(const char* path);
+
+ private:
+  static TraceRecord* s_Records;
+  static uint64_t s_Mask;
+  static uint64_t s_Next;
+};
+
+/* Records the time from construction to destruction as one event */
+class TraceScope
+{
+ public:
+  TraceScope(TraceEvent event, uint16_t address = 0) :
+    m_Event(event),
+    m_Address(address),
+    m_Start(Trace::enabled() ? monotonicNs() : 0)
+  {
+  }
+
+  ~TraceScope()
+  {
+    stop();
+  }
+
+  /* End the event before the scope does */
+  void stop()
+  {
+    if(m_Start) {
+      Trace::record(m_Event, m_Address, m_Start, monotonicNs());
+      m_Start = 0;
+    }
+  }
+
+ private:
+  TraceEvent m_Event;
+  uint16_t m_Address;
+  uint64_t m_Start;
+};
+#endif
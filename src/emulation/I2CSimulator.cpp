@@ -0,0 +1,388 @@
+#include "I2CSimulator.h"
+#include "TrackSimulator.h"
+
+#include <wiringPi.h>
+#include <wiringPiI2C.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <iostream>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/foreach.hpp>
+
+/* File descriptors handed out by wiringPiI2CSetup() encode the device address */
+#define SIM_FD_BASE 0x10000
+
+/* Bits on the wire around the payload: start, address + ack, register + ack, stop */
+#define SIM_WRITE_OVERHEAD (1 + 9 + 9 + 1)
+/* A read adds a repeated start and the address again */
+#define SIM_READ_OVERHEAD (SIM_WRITE_OVERHEAD + 1 + 9)
+/* A device busy ranging still costs the NACKed address */
+#define SIM_NACK_BITS (1 + 9 + 1)
+/* Like the kernel, refuse SMBus blocks longer than 32 bytes */
+#define SMBUS_BLOCK_MAX 32
+
+static void printStatisticsAtExit()
+{
+  I2CSimulator::instance().printStatistics(std::cerr);
+}
+
+static TrackSimulator* s_Track = NULL;
+
+static void printTrackStatisticsAtExit()
+{
+  s_Track->printStatistics(std::cerr);
+}
+
+I2CSimulator& I2CSimulator::instance()
+{
+  /* Never destroyed, the interrupt thread may still run at exit */
+  static I2CSimulator* simulator = new I2CSimulator();
+  return *simulator;
+}
+
+I2CSimulator::I2CSimulator() :
+  m_Track(NULL),
+  m_Khz(100),
+  m_Delay(true),
+  m_Start(now()),
+  m_InterruptThreadRunning(false)
+{
+  pthread_mutex_init(&m_Mutex, NULL);
+  pthread_mutex_init(&m_InterruptMutex, NULL);
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&m_InterruptCond, &attr);
+  pthread_condattr_destroy(&attr);
+
+  const char* delay = getenv("ROBOT_SIM_BUS_DELAY");
+  if(delay && atoi(delay) == 0) {
+    m_Delay = false;
+  }
+  const char* khz = getenv("ROBOT_SIM_I2C_KHZ");
+  if(khz && atoi(khz) > 0) {
+    m_Khz = atoi(khz);
+  }
+  const char* cfg = getenv("ROBOT_SIM_CONFIG");
+  loadConfig(cfg ? cfg : "robot.json");
+  if(getenv("ROBOT_SIM_STATS")) {
+    atexit(printStatisticsAtExit);
+  }
+  if(m_Track) {
+    s_Track = m_Track;
+    m_Track->start();
+    atexit(printTrackStatisticsAtExit);
+  }
+}
+
+I2CSimulator::~I2CSimulator()
+{
+  delete m_Track;
+  for(std::map<uint8_t, SimulatedDevice*>::iterator iter=m_Devices.begin(); iter!=m_Devices.end(); ++iter) {
+    delete iter->second;
+  }
+}
+
+void I2CSimulator::loadConfig(const char* cfg)
+{
+  if(access(cfg, R_OK) != 0) {
+    return;
+  }
+  boost::property_tree::ptree pt;
+  try {
+    boost::property_tree::json_parser::read_json(cfg, pt);
+    BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, pt.get_child("robot.pwm")) {
+      m_Types[child.second.get<int>("address")] = PCA9685;
+    }
+    BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, pt.get_child("robot.ADCs")) {
+      int addr = child.second.get<int>("address");
+      m_Types[addr] = ADS1115;
+      m_AlertPins[addr] = child.second.get<int>("alertPin", -1);
+    }
+    BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, pt.get_child("robot.sensors")) {
+      if(child.second.get<std::string>("type") == "srf08") {
+        m_Types[child.second.get<int>("address")] = SRF08;
+      }
+    }
+  } catch(boost::property_tree::ptree_error& e) {
+    std::cerr << "I2C simulator: failed to read " << cfg << ", using default addresses" << std::endl;
+    return;
+  }
+
+  const char* track = getenv("ROBOT_SIM_TRACK");
+  if(track) {
+    try {
+      m_Track = new TrackSimulator(*this, pt);
+    } catch(boost::property_tree::ptree_error& e) {
+      std::cerr << "I2C simulator: incomplete configuration for the track simulator" << std::endl;
+      return;
+    }
+    if(!m_Track->loadTrack(track)) {
+      std::cerr << "I2C simulator: failed to load track " << track << std::endl;
+      delete m_Track;
+      m_Track = NULL;
+    }
+  }
+}
+
+SimulatedDevice* I2CSimulator::createDevice(uint8_t address)
+{
+  DeviceType type = UNKNOWN;
+  std::map<uint8_t, DeviceType>::const_iterator iter = m_Types.find(address);
+  if(iter != m_Types.end()) {
+    type = iter->second;
+  } else if(address >= 0x90 && address <= 0x96) {
+    type = ADS1115;
+  } else if(address >= 0xE0) {
+    type = SRF08;
+  } else if(address >= 0x80) {
+    type = PCA9685;
+  }
+
+  switch(type) {
+  case SRF08:
+    return new SimulatedSRF08(*this, address);
+  case ADS1115: {
+    std::map<uint8_t, int>::const_iterator pin = m_AlertPins.find(address);
+    return new SimulatedADS1115(*this, address, (pin == m_AlertPins.end()) ? -1 : pin->second);
+  }
+  case PCA9685:
+    return new SimulatedPCA9685(*this, address);
+  default:
+    return NULL;
+  }
+}
+
+int I2CSimulator::setup(uint8_t address)
+{
+  /* wiringPi takes the 7-bit address, the configuration and models use 8-bit ones */
+  uint8_t addr = address << 1;
+  pthread_mutex_lock(&m_Mutex);
+  if(m_Devices.find(addr) == m_Devices.end()) {
+    SimulatedDevice* device = createDevice(addr);
+    if(device) {
+      m_Devices[addr] = device;
+    }
+  }
+  pthread_mutex_unlock(&m_Mutex);
+  return SIM_FD_BASE + addr;
+}
+
+SimulatedDevice* I2CSimulator::getDevice(int fd)
+{
+  std::map<uint8_t, SimulatedDevice*>::const_iterator iter = m_Devices.find(fd - SIM_FD_BASE);
+  return (fd < SIM_FD_BASE || iter == m_Devices.end()) ? NULL : iter->second;
+}
+
+uint64_t I2CSimulator::charge(uint8_t address, int bits, bool failed)
+{
+  uint64_t duration = (uint64_t)bits * 1000000 / m_Khz;
+  Statistics& stats = m_Statistics[address];
+  stats.transactions++;
+  stats.busTime += duration;
+  if(failed) {
+    stats.failures++;
+  }
+  return duration;
+}
+
+int I2CSimulator::read(int fd, uint8_t reg, uint8_t* data, int length)
+{
+  pthread_mutex_lock(&m_Mutex);
+  SimulatedDevice* device = getDevice(fd);
+  int ret = device ? device->read(reg, data, length) : -1;
+  uint64_t duration = charge(fd - SIM_FD_BASE, (ret < 0) ? SIM_NACK_BITS : SIM_READ_OVERHEAD + 9 * length, ret < 0);
+  pthread_mutex_unlock(&m_Mutex);
+  if(m_Delay) {
+    struct timespec wait = { 0, (long)duration };
+    nanosleep(&wait, NULL);
+  }
+  return ret;
+}
+
+int I2CSimulator::write(int fd, uint8_t reg, const uint8_t* data, int length)
+{
+  pthread_mutex_lock(&m_Mutex);
+  SimulatedDevice* device = getDevice(fd);
+  int ret = device ? device->write(reg, data, length) : -1;
+  uint64_t duration = charge(fd - SIM_FD_BASE, (ret < 0) ? SIM_NACK_BITS : SIM_WRITE_OVERHEAD + 9 * length, ret < 0);
+  pthread_mutex_unlock(&m_Mutex);
+  if(m_Delay) {
+    struct timespec wait = { 0, (long)duration };
+    nanosleep(&wait, NULL);
+  }
+  return ret;
+}
+
+void I2CSimulator::lock()
+{
+  pthread_mutex_lock(&m_Mutex);
+}
+
+void I2CSimulator::unlock()
+{
+  pthread_mutex_unlock(&m_Mutex);
+}
+
+SimulatedSRF08* I2CSimulator::getSRF08(uint8_t address)
+{
+  pthread_mutex_lock(&m_Mutex);
+  std::map<uint8_t, SimulatedDevice*>::const_iterator iter = m_Devices.find(address);
+  SimulatedDevice* device = (iter == m_Devices.end()) ? NULL : iter->second;
+  pthread_mutex_unlock(&m_Mutex);
+  return dynamic_cast<SimulatedSRF08*>(device);
+}
+
+SimulatedADS1115* I2CSimulator::getADS1115(uint8_t address)
+{
+  pthread_mutex_lock(&m_Mutex);
+  std::map<uint8_t, SimulatedDevice*>::const_iterator iter = m_Devices.find(address);
+  SimulatedDevice* device = (iter == m_Devices.end()) ? NULL : iter->second;
+  pthread_mutex_unlock(&m_Mutex);
+  return dynamic_cast<SimulatedADS1115*>(device);
+}
+
+SimulatedPCA9685* I2CSimulator::getPCA9685(uint8_t address)
+{
+  pthread_mutex_lock(&m_Mutex);
+  std::map<uint8_t, SimulatedDevice*>::const_iterator iter = m_Devices.find(address);
+  SimulatedDevice* device = (iter == m_Devices.end()) ? NULL : iter->second;
+  pthread_mutex_unlock(&m_Mutex);
+  return dynamic_cast<SimulatedPCA9685*>(device);
+}
+
+void I2CSimulator::scheduleInterrupt(int pin, uint64_t time)
+{
+  pthread_mutex_lock(&m_InterruptMutex);
+  if(!m_InterruptThreadRunning) {
+    m_InterruptThreadRunning = (pthread_create(&m_InterruptThread, NULL, &I2CSimulator::interruptThreadMain, this) == 0);
+    if(m_InterruptThreadRunning) {
+      pthread_detach(m_InterruptThread);
+    }
+  }
+  m_Interrupts.insert(std::pair<uint64_t, int>(time, pin));
+  pthread_cond_signal(&m_InterruptCond);
+  pthread_mutex_unlock(&m_InterruptMutex);
+}
+
+void* I2CSimulator::interruptThreadMain(void* arg)
+{
+  static_cast<I2CSimulator*>(arg)->interruptThread();
+  return NULL;
+}
+
+/* Stands in for the wiringPi interrupt thread: handlers run off the caller's thread */
+void I2CSimulator::interruptThread()
+{
+  pthread_mutex_lock(&m_InterruptMutex);
+  while(true) {
+    if(m_Interrupts.empty()) {
+      pthread_cond_wait(&m_InterruptCond, &m_InterruptMutex);
+      continue;
+    }
+    uint64_t time = m_Interrupts.begin()->first;
+    if(now() < time) {
+      struct timespec deadline = { (time_t)(time / 1000000000), (long)(time % 1000000000) };
+      pthread_cond_timedwait(&m_InterruptCond, &m_InterruptMutex, &deadline);
+      continue;
+    }
+    int pin = m_Interrupts.begin()->second;
+    m_Interrupts.erase(m_Interrupts.begin());
+    pthread_mutex_unlock(&m_InterruptMutex);
+    emulateInterrupt(pin);
+    pthread_mutex_lock(&m_InterruptMutex);
+  }
+}
+
+uint64_t I2CSimulator::getBusTime()
+{
+  uint64_t total = 0;
+  pthread_mutex_lock(&m_Mutex);
+  for(std::map<uint8_t, Statistics>::const_iterator iter=m_Statistics.begin(); iter!=m_Statistics.end(); ++iter) {
+    total += iter->second.busTime;
+  }
+  pthread_mutex_unlock(&m_Mutex);
+  return total;
+}
+
+uint64_t I2CSimulator::getTransactions()
+{
+  uint64_t total = 0;
+  pthread_mutex_lock(&m_Mutex);
+  for(std::map<uint8_t, Statistics>::const_iterator iter=m_Statistics.begin(); iter!=m_Statistics.end(); ++iter) {
+    total += iter->second.transactions;
+  }
+  pthread_mutex_unlock(&m_Mutex);
+  return total;
+}
+
+void I2CSimulator::printStatistics(std::ostream& out)
+{
+  uint64_t elapsed = now() - m_Start;
+  uint64_t busTime = getBusTime();
+  out << "I2C bus at " << m_Khz << " kHz, " << elapsed / 1000 << " us simulated" << std::endl;
+  pthread_mutex_lock(&m_Mutex);
+  for(std::map<uint8_t, Statistics>::const_iterator iter=m_Statistics.begin(); iter!=m_Statistics.end(); ++iter) {
+    out << "  0x" << std::hex << (int)iter->first << std::dec << ": "
+        << iter->second.transactions << " transactions ("
+        << iter->second.failures << " NACKed), "
+        << iter->second.busTime / 1000 << " us" << std::endl;
+  }
+  pthread_mutex_unlock(&m_Mutex);
+  out << "  total: " << busTime / 1000 << " us, "
+      << (elapsed ? (100.0 * busTime / elapsed) : 0.0) << "% bus load" << std::endl;
+}
+
+uint64_t I2CSimulator::now()
+{
+  struct timespec spec;
+  clock_gettime(CLOCK_MONOTONIC, &spec);
+  return (uint64_t)spec.tv_sec * 1000000000 + spec.tv_nsec;
+}
+
+int wiringPiI2CSetup(uint8_t addr)
+{
+  return I2CSimulator::instance().setup(addr);
+}
+
+int wiringPiI2CWriteReg8(int fd, uint8_t reg, uint8_t val)
+{
+  return (I2CSimulator::instance().write(fd, reg, &val, 1) < 0) ? -1 : 0;
+}
+
+int wiringPiI2CReadReg8(int fd, uint8_t reg)
+{
+  uint8_t val;
+  return (I2CSimulator::instance().read(fd, reg, &val, 1) < 0) ? -1 : val;
+}
+
+int wiringPiI2CReadBlockData(int fd, int reg, int length, uint8_t* values)
+{
+  if(length > SMBUS_BLOCK_MAX) {
+    return -1;
+  }
+  return I2CSimulator::instance().read(fd, reg, values, length);
+}
+
+/* SMBus words go low byte first */
+int wiringPiI2CWriteReg16(int fd, uint8_t reg, uint16_t val)
+{
+  uint8_t buf[2] = { (uint8_t)(val & 0xFF), (uint8_t)(val >> 8) };
+  return (I2CSimulator::instance().write(fd, reg, buf, 2) < 0) ? -1 : 0;
+}
+
+int wiringPiI2CReadReg16(int fd, uint8_t reg)
+{
+  uint8_t buf[2];
+  return (I2CSimulator::instance().read(fd, reg, buf, 2) < 0) ? -1 : (buf[0] | (buf[1] << 8));
+}
+
+int wiringPiI2CWriteBlockData(int fd, int reg, int length, uint8_t* values)
+{
+  if(length > SMBUS_BLOCK_MAX) {
+    return -1;
+  }
+  return I2CSimulator::instance().write(fd, reg, values, length);
+}
@@ -0,0 +1,88 @@
+#ifndef I2C_SIMULATOR_H
+#define I2C_SIMULATOR_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <map>
+#include <string>
+#include <ostream>
+
+#include "SimulatedDevices.h"
+
+class TrackSimulator;
+
+/* Simulated I2C bus behind the emulated wiringPiI2C calls.
+
+   Devices are created on wiringPiI2CSetup() from the addresses in the robot
+   configuration (ROBOT_SIM_CONFIG, default robot.json). Unknown addresses
+   fall back to the usual address ranges of the three supported parts.
+   Every transaction is charged the time it takes on the wire at the bus
+   clock given by ROBOT_SIM_I2C_KHZ (100 or 400, default 100) and the
+   caller is stalled for that time unless ROBOT_SIM_BUS_DELAY=0.
+   ROBOT_SIM_STATS prints the bus statistics at exit. ROBOT_SIM_TRACK
+   drives the sensors from a simulated track, see TrackSimulator. */
+class I2CSimulator
+{
+ public:
+  static I2CSimulator& instance();
+  ~I2CSimulator();
+
+  int setup(uint8_t address);
+  int read(int fd, uint8_t reg, uint8_t* data, int length);
+  int write(int fd, uint8_t reg, const uint8_t* data, int length);
+
+  /* Device models by 8-bit address as used in robot.json */
+  SimulatedSRF08* getSRF08(uint8_t address);
+  SimulatedADS1115* getADS1115(uint8_t address);
+  SimulatedPCA9685* getPCA9685(uint8_t address);
+
+  /* Serialises access to the device models with the bus */
+  void lock();
+  void unlock();
+
+  /* Raise an emulated GPIO interrupt at an absolute CLOCK_MONOTONIC time */
+  void scheduleInterrupt(int pin, uint64_t time);
+
+  uint64_t getBusTime();
+  uint64_t getTransactions();
+  void printStatistics(std::ostream& out);
+
+  static uint64_t now();
+
+ private:
+  I2CSimulator();
+
+  enum DeviceType { UNKNOWN, SRF08, ADS1115, PCA9685 };
+
+  struct Statistics
+  {
+    uint64_t transactions;
+    uint64_t failures;
+    uint64_t busTime;
+  };
+
+  void loadConfig(const char* cfg);
+  SimulatedDevice* createDevice(uint8_t address);
+  SimulatedDevice* getDevice(int fd);
+  uint64_t charge(uint8_t address, int bits, bool failed);
+
+  static void* interruptThreadMain(void* arg);
+  void interruptThread();
+
+  pthread_mutex_t m_Mutex;
+  std::map<uint8_t, DeviceType> m_Types;
+  std::map<uint8_t, int> m_AlertPins;
+  std::map<uint8_t, SimulatedDevice*> m_Devices;
+  std::map<uint8_t, Statistics> m_Statistics;
+  TrackSimulator* m_Track;
+  int m_Khz;
+  bool m_Delay;
+  uint64_t m_Start;
+
+  pthread_mutex_t m_InterruptMutex;
+  pthread_cond_t m_InterruptCond;
+  pthread_t m_InterruptThread;
+  bool m_InterruptThreadRunning;
+  std::multimap<uint64_t, int> m_Interrupts;
+};
+#endif
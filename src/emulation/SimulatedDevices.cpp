@@ -0,0 +1,313 @@
+#include "SimulatedDevices.h"
+#include "I2CSimulator.h"
+
+#include <string.h>
+
+SimulatedDevice::SimulatedDevice(I2CSimulator& bus, uint8_t address) :
+  m_Bus(bus),
+  m_Address(address)
+{
+}
+
+SimulatedDevice::~SimulatedDevice()
+{
+}
+
+uint8_t SimulatedDevice::getAddress()
+{
+  return m_Address;
+}
+
+/* SRF08 */
+
+#define SRF08_SOFTWARE_REVISION 10
+/* Each range register step adds 43 mm, the echo has to travel that twice at 343 m/s */
+#define SRF08_NS_PER_RANGE_STEP 250729
+#define SRF08_MM_PER_RANGE_STEP 43
+
+SimulatedSRF08::SimulatedSRF08(I2CSimulator& bus, uint8_t address) :
+  SimulatedDevice(bus, address),
+  m_Gain(31),
+  m_Range(255),
+  m_EchoCount(1),
+  m_ReadyTime(0)
+{
+  memset(m_Registers, 0, sizeof(m_Registers));
+  m_Registers[0] = SRF08_SOFTWARE_REVISION;
+  m_Registers[1] = 0x80;
+  m_Echoes[0] = 150;
+}
+
+void SimulatedSRF08::setEchoes(const uint16_t* echoesCm, int count)
+{
+  m_EchoCount = (count > MAX_ECHOES) ? MAX_ECHOES : count;
+  memcpy(m_Echoes, echoesCm, m_EchoCount * sizeof(uint16_t));
+}
+
+void SimulatedSRF08::setLightLevel(uint8_t light)
+{
+  m_Registers[1] = light;
+}
+
+bool SimulatedSRF08::ranging()
+{
+  return I2CSimulator::now() < m_ReadyTime;
+}
+
+int SimulatedSRF08::read(uint8_t reg, uint8_t* data, int length)
+{
+  /* The SRF08 does not respond to the bus at all while ranging */
+  if(ranging()) {
+    return -1;
+  }
+  for(int i = 0; i < length; ++i) {
+    data[i] = (reg + i < (int)sizeof(m_Registers)) ? m_Registers[reg + i] : 0;
+  }
+  return length;
+}
+
+int SimulatedSRF08::write(uint8_t reg, const uint8_t* data, int length)
+{
+  if(ranging()) {
+    return -1;
+  }
+  if(length < 1) {
+    return length;
+  }
+  switch(reg) {
+  case 0:
+    if(data[0] >= 0x50 && data[0] <= 0x52) {
+      /* Latch the echoes in the requested unit, anything beyond the range register is lost */
+      memset(&m_Registers[2], 0, sizeof(m_Registers) - 2);
+      int maxRange = (m_Range + 1) * SRF08_MM_PER_RANGE_STEP / 10;
+      for(int i = 0, echo = 0; i < m_EchoCount; ++i) {
+        if(m_Echoes[i] > maxRange) {
+          continue;
+        }
+        uint16_t value = m_Echoes[i];
+        if(data[0] == 0x50) {
+          value = value * 100 / 254;
+        } else if(data[0] == 0x52) {
+          value = value * 20000 / 343;
+        }
+        m_Registers[2 + 2*echo] = value >> 8;
+        m_Registers[3 + 2*echo] = value & 0xFF;
+        ++echo;
+      }
+      m_ReadyTime = I2CSimulator::now() + (uint64_t)(m_Range + 1) * SRF08_NS_PER_RANGE_STEP;
+    }
+    break;
+  case 1:
+    m_Gain = data[0];
+    if(length > 1) {
+      m_Range = data[1];
+    }
+    break;
+  case 2:
+    m_Range = data[0];
+    break;
+  }
+  return length;
+}
+
+/* ADS1115 */
+
+static const int s_AdsSamplesPerSecond[] = { 8, 16, 32, 64, 128, 250, 475, 860 };
+static const float s_AdsFullScaleMilliVolts[] = { 6144, 4096, 2048, 1024, 512, 256, 256, 256 };
+/* Positive and negative input per multiplexer setting, -1 is GND */
+static const int s_AdsMux[8][2] = { {0, 1}, {0, 3}, {1, 3}, {2, 3}, {0, -1}, {1, -1}, {2, -1}, {3, -1} };
+
+SimulatedADS1115::SimulatedADS1115(I2CSimulator& bus, uint8_t address, int alertPin) :
+  SimulatedDevice(bus, address),
+  m_Config(0x8583),
+  m_Conversion(0),
+  m_LowThreshold(0x8000),
+  m_HighThreshold(0x7FFF),
+  m_AlertPin(alertPin),
+  m_Converting(false),
+  m_ReadyTime(0)
+{
+  for(int i = 0; i < 4; ++i) {
+    m_Inputs[i] = 1000;
+  }
+}
+
+void SimulatedADS1115::setInputMilliVolts(int input, float millivolts)
+{
+  if(input >= 0 && input < 4) {
+    m_Inputs[input] = millivolts;
+  }
+}
+
+uint64_t SimulatedADS1115::conversionTime()
+{
+  return 1000000000ULL / s_AdsSamplesPerSecond[(m_Config >> 5) & 0x07];
+}
+
+int16_t SimulatedADS1115::convert()
+{
+  const int* mux = s_AdsMux[(m_Config >> 12) & 0x07];
+  float millivolts = m_Inputs[mux[0]] - ((mux[1] < 0) ? 0 : m_Inputs[mux[1]]);
+  float counts = millivolts / s_AdsFullScaleMilliVolts[(m_Config >> 9) & 0x07] * 32768;
+  if(counts > 32767) {
+    return 32767;
+  }
+  if(counts < -32768) {
+    return -32768;
+  }
+  return (int16_t)counts;
+}
+
+bool SimulatedADS1115::continuous()
+{
+  return !(m_Config & 0x0100);
+}
+
+void SimulatedADS1115::update()
+{
+  if(continuous()) {
+    m_Conversion = convert();
+  } else if(m_Converting && I2CSimulator::now() >= m_ReadyTime) {
+    m_Conversion = convert();
+    m_Converting = false;
+  }
+}
+
+int SimulatedADS1115::read(uint8_t reg, uint8_t* data, int length)
+{
+  update();
+  uint16_t value = 0;
+  switch(reg) {
+  case 0:
+    value = m_Conversion;
+    break;
+  case 1:
+    /* OS reads 1 when no conversion is running */
+    value = m_Config | ((continuous() || m_Converting) ? 0 : 0x8000);
+    break;
+  case 2:
+    value = m_LowThreshold;
+    break;
+  case 3:
+    value = m_HighThreshold;
+    break;
+  default:
+    return -1;
+  }
+  for(int i = 0; i < length; ++i) {
+    data[i] = (i == 0) ? (value >> 8) : (i == 1) ? (value & 0xFF) : 0;
+  }
+  return length;
+}
+
+int SimulatedADS1115::write(uint8_t reg, const uint8_t* data, int length)
+{
+  if(length != 2) {
+    return -1;
+  }
+  uint16_t value = (data[0] << 8) | data[1];
+  switch(reg) {
+  case 1:
+    update();
+    m_Config = value & 0x7FFF;
+    if(!continuous() && (value & 0x8000) && !m_Converting) {
+      m_Converting = true;
+      m_ReadyTime = I2CSimulator::now() + conversionTime();
+      /* Conversion-ready mode: Hi_thresh MSB set, Lo_thresh MSB clear, comparator enabled */
+      if(m_AlertPin >= 0 && m_HighThreshold < 0 && m_LowThreshold >= 0 && (m_Config & 0x03) != 0x03) {
+        m_Bus.scheduleInterrupt(m_AlertPin, m_ReadyTime);
+      }
+    }
+    break;
+  case 2:
+    m_LowThreshold = value;
+    break;
+  case 3:
+    m_HighThreshold = value;
+    break;
+  default:
+    return -1;
+  }
+  return length;
+}
+
+/* PCA9685 */
+
+#define PCA9685_OSCILLATOR 25000000.0f
+
+SimulatedPCA9685::SimulatedPCA9685(I2CSimulator& bus, uint8_t address) :
+  SimulatedDevice(bus, address)
+{
+  memset(m_Registers, 0, sizeof(m_Registers));
+  m_Registers[0x00] = 0x11;
+  m_Registers[0x01] = 0x04;
+  m_Registers[0xFE] = 0x1E;
+  for(int channel = 0; channel < 16; ++channel) {
+    m_Registers[0x09 + 4*channel] = 0x10;
+  }
+}
+
+float SimulatedPCA9685::getFrequency()
+{
+  return PCA9685_OSCILLATOR / (4096 * (m_Registers[0xFE] + 1));
+}
+
+/* High time of a channel in ticks of 1/4096 period */
+int SimulatedPCA9685::getPulse(uint8_t channel)
+{
+  if(channel >= 16 || (m_Registers[0x00] & 0x10)) {
+    return 0;
+  }
+  const uint8_t* led = &m_Registers[0x06 + 4*channel];
+  if(led[3] & 0x10) {
+    return 0;
+  }
+  if(led[1] & 0x10) {
+    return 4096;
+  }
+  int on = led[0] | ((led[1] & 0x0F) << 8);
+  int off = led[2] | ((led[3] & 0x0F) << 8);
+  return (off - on + 4096) % 4096;
+}
+
+void SimulatedPCA9685::writeRegister(uint8_t reg, uint8_t value)
+{
+  if(reg == 0xFE) {
+    /* The prescaler can only be changed while the oscillator sleeps */
+    if(m_Registers[0x00] & 0x10) {
+      m_Registers[reg] = value;
+    }
+  } else if(reg >= 0xFA && reg <= 0xFD) {
+    for(int channel = 0; channel < 16; ++channel) {
+      m_Registers[0x06 + 4*channel + (reg - 0xFA)] = value;
+    }
+  } else if(reg == 0x00) {
+    m_Registers[reg] = value & 0x7F;
+  } else {
+    m_Registers[reg] = value;
+  }
+}
+
+int SimulatedPCA9685::read(uint8_t reg, uint8_t* data, int length)
+{
+  bool autoIncrement = m_Registers[0x00] & 0x20;
+  for(int i = 0; i < length; ++i) {
+    data[i] = m_Registers[reg];
+    if(autoIncrement) {
+      ++reg;
+    }
+  }
+  return length;
+}
+
+int SimulatedPCA9685::write(uint8_t reg, const uint8_t* data, int length)
+{
+  for(int i = 0; i < length; ++i) {
+    writeRegister(reg, data[i]);
+    /* Without auto-increment every byte lands in the same register */
+    if(m_Registers[0x00] & 0x20) {
+      ++reg;
+    }
+  }
+  return length;
+}
@@ -0,0 +1,100 @@
+#ifndef SIMULATED_DEVICES_H
+#define SIMULATED_DEVICES_H
+
+#include <stdint.h>
+
+class I2CSimulator;
+
+/* Register model of one I2C slave. Transfers return the number of bytes
+   handled, or -1 when the device would not acknowledge its address. */
+class SimulatedDevice
+{
+ public:
+  SimulatedDevice(I2CSimulator& bus, uint8_t address);
+  virtual ~SimulatedDevice();
+
+  uint8_t getAddress();
+
+  virtual int read(uint8_t reg, uint8_t* data, int length) = 0;
+  virtual int write(uint8_t reg, const uint8_t* data, int length) = 0;
+
+ protected:
+  I2CSimulator& m_Bus;
+  uint8_t m_Address;
+};
+
+/* SRF08 ultrasonic ranger. The range is latched when a ping is fired and
+   the device ignores the bus until the ranging time set by the range
+   register has passed. */
+class SimulatedSRF08 : public SimulatedDevice
+{
+ public:
+  SimulatedSRF08(I2CSimulator& bus, uint8_t address);
+
+  void setEchoes(const uint16_t* echoesCm, int count);
+  void setLightLevel(uint8_t light);
+
+  virtual int read(uint8_t reg, uint8_t* data, int length);
+  virtual int write(uint8_t reg, const uint8_t* data, int length);
+
+  static const int MAX_ECHOES = 17;
+
+ private:
+  bool ranging();
+
+  uint8_t m_Registers[36];
+  uint8_t m_Gain;
+  uint8_t m_Range;
+  uint16_t m_Echoes[MAX_ECHOES];
+  int m_EchoCount;
+  uint64_t m_ReadyTime;
+};
+
+/* ADS1115 ADC with CONFIG/CONVERSION/threshold registers, single-shot and
+   continuous conversions timed by the data rate, and the ALERT/RDY pin
+   raised as emulated GPIO interrupt in conversion-ready mode. */
+class SimulatedADS1115 : public SimulatedDevice
+{
+ public:
+  SimulatedADS1115(I2CSimulator& bus, uint8_t address, int alertPin);
+
+  void setInputMilliVolts(int input, float millivolts);
+
+  virtual int read(uint8_t reg, uint8_t* data, int length);
+  virtual int write(uint8_t reg, const uint8_t* data, int length);
+
+ private:
+  uint64_t conversionTime();
+  bool continuous();
+  int16_t convert();
+  void update();
+
+  uint16_t m_Config;
+  int16_t m_Conversion;
+  int16_t m_LowThreshold;
+  int16_t m_HighThreshold;
+  float m_Inputs[4];
+  int m_AlertPin;
+  bool m_Converting;
+  uint64_t m_ReadyTime;
+};
+
+/* PCA9685 PWM controller with auto-increment, sleep-gated prescaler and
+   per-channel LED registers. */
+class SimulatedPCA9685 : public SimulatedDevice
+{
+ public:
+  SimulatedPCA9685(I2CSimulator& bus, uint8_t address);
+
+  float getFrequency();
+  int getPulse(uint8_t channel);
+
+  virtual int read(uint8_t reg, uint8_t* data, int length);
+  virtual int write(uint8_t reg, const uint8_t* data, int length);
+
+ private:
+  void writeRegister(uint8_t reg, uint8_t value);
+
+  uint8_t m_Registers[256];
+};
+#endif
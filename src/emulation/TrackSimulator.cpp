@@ -0,0 +1,476 @@
+#include "TrackSimulator.h"
+#include "I2CSimulator.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <linux/input.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <map>
+#include <boost/foreach.hpp>
+
+#define PHYSICS_PERIOD_NS 1000000
+/* Mouse packets go out every 10 physics steps, i.e. at 100 Hz like a PS/2 mouse.
+   Evdev sensors report every step like a 1 kHz gaming mouse. */
+#define MOUSE_PACKET_STEPS 10
+#define EVDEV_REPORT_STEPS 1
+#define MAX_RAY_RANGE 1100.0
+#define THROTTLE_DEADBAND 0.02
+#define STOPPED_SPEED 5.0
+
+static unsigned int s_Seed = 1;
+
+static double degreesToRadians(double degrees)
+{
+  return degrees * M_PI / 180.0;
+}
+
+TrackSimulator::TrackSimulator(I2CSimulator& bus, const boost::property_tree::ptree& cfg) :
+  m_Bus(bus),
+  m_HasFinish(false),
+  m_X(0),
+  m_Y(0),
+  m_Heading(0),
+  m_Speed(0),
+  m_DeltaForward(0),
+  m_DeltaHeading(0),
+  m_Braking(false),
+  m_ReverseArmed(false),
+  m_InCollision(false),
+  m_Running(false),
+  m_Start(0),
+  m_LapStart(0),
+  m_Collisions(0),
+  m_Distance(0)
+{
+  pthread_mutex_init(&m_Mutex, NULL);
+  const char* seed = getenv("ROBOT_SIM_SEED");
+  if(seed) {
+    s_Seed = atoi(seed);
+  }
+
+  std::map<std::string, uint8_t> pwms;
+  BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, cfg.get_child("robot.pwm")) {
+    pwms[child.second.get<std::string>("name")] = child.second.get<int>("address");
+  }
+  m_SteeringPwm = pwms[cfg.get<std::string>("robot.steering.pwm")];
+  m_SteeringChannel = cfg.get<int>("robot.steering.channel");
+  m_SteeringLeft = cfg.get<double>("robot.steering.maxLeft");
+  m_SteeringRight = cfg.get<double>("robot.steering.maxRight");
+  m_MotorPwm = pwms[cfg.get<std::string>("robot.motor.pwm")];
+  m_MotorChannel = cfg.get<int>("robot.motor.channel");
+  m_MotorForward = cfg.get<double>("robot.motor.maxForward");
+  m_MotorReverse = cfg.get<double>("robot.motor.maxReverse");
+
+  m_WheelBase = cfg.get<double>("robot.simulation.wheelBase", 26);
+  m_Radius = cfg.get<double>("robot.simulation.radius", 15);
+  m_MaxSteering = degreesToRadians(cfg.get<double>("robot.simulation.maxSteeringAngle", 25));
+  m_MaxSpeed = cfg.get<double>("robot.simulation.maxSpeed", 500);
+  m_Acceleration = cfg.get<double>("robot.simulation.acceleration", 400);
+  m_BrakeDeceleration = cfg.get<double>("robot.simulation.brakeDeceleration", 800);
+  m_CountsPerCm = cfg.get<double>("robot.simulation.countsPerCm", 60);
+
+  std::map<std::string, uint8_t> adcs;
+  BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, cfg.get_child("robot.ADCs")) {
+    adcs[child.second.get<std::string>("name")] = child.second.get<int>("address");
+  }
+  BOOST_FOREACH(const boost::property_tree::ptree::value_type& child, cfg.get_child("robot.sensors")) {
+    std::string type = child.second.get<std::string>("type");
+    if(type == "srf08") {
+      RangeSensor sensor;
+      sensor.address = child.second.get<int>("address");
+      sensor.channel = 0;
+      sensor.angle = -degreesToRadians(child.second.get<double>("angle"));
+      m_Ultrasonic.push_back(sensor);
+    } else if(type == "analog") {
+      RangeSensor sensor;
+      sensor.address = adcs[child.second.get<std::string>("adc")];
+      sensor.channel = child.second.get<int>("channel");
+      sensor.angle = degreesToRadians(child.second.get<double>("angle") - 90);
+      m_Infrared.push_back(sensor);
+    } else if(type == "speed") {
+      std::string device = child.second.get<std::string>("device");
+      struct stat st;
+      if(stat(device.c_str(), &st) != 0) {
+        mkfifo(device.c_str(), 0666);
+      } else if(!S_ISFIFO(st.st_mode)) {
+        std::cerr << "Track simulator: " << device << " is not a FIFO, mouse not simulated" << std::endl;
+        continue;
+      }
+      MouseSensor mouse;
+      mouse.fd = open(device.c_str(), O_RDWR | O_NONBLOCK);
+      mouse.evdev = child.second.get<std::string>("driver", "mouse") == "evdev";
+      mouse.interval = mouse.evdev ? EVDEV_REPORT_STEPS : MOUSE_PACKET_STEPS;
+      mouse.steps = 0;
+      /* Mounting in mm like the robot reads it, x forward and y to the left */
+      mouse.x = child.second.get<double>("x", 0) / 10;
+      mouse.y = child.second.get<double>("y", 0) / 10;
+      mouse.cos = cos(degreesToRadians(child.second.get<double>("angle", 0)));
+      mouse.sin = sin(degreesToRadians(child.second.get<double>("angle", 0)));
+      mouse.residualX = 0;
+      mouse.residualY = 0;
+      if(mouse.fd != -1) {
+        m_Mice.push_back(mouse);
+      }
+    }
+  }
+}
+
+TrackSimulator::~TrackSimulator()
+{
+  if(m_Running) {
+    m_Running = false;
+    pthread_join(m_Thread, NULL);
+  }
+  for(size_t i = 0; i < m_Mice.size(); ++i) {
+    close(m_Mice[i].fd);
+  }
+  pthread_mutex_destroy(&m_Mutex);
+}
+
+bool TrackSimulator::loadTrack(const char* file)
+{
+  std::ifstream in(file);
+  if(!in) {
+    return false;
+  }
+  std::string line;
+  while(std::getline(in, line)) {
+    std::istringstream items(line);
+    std::string item;
+    if(!(items >> item) || item[0] == '#') {
+      continue;
+    }
+    if(item == "wall") {
+      Segment wall;
+      if(items >> wall.x1 >> wall.y1 >> wall.x2 >> wall.y2) {
+        m_Walls.push_back(wall);
+      }
+    } else if(item == "start") {
+      double heading;
+      if(items >> m_X >> m_Y >> heading) {
+        m_Heading = degreesToRadians(heading);
+      }
+    } else if(item == "finish") {
+      m_HasFinish = !(items >> m_Finish.x1 >> m_Finish.y1 >> m_Finish.x2 >> m_Finish.y2).fail();
+    } else {
+      std::cerr << "Track simulator: unknown item " << item << " in " << file << std::endl;
+    }
+  }
+  return !m_Walls.empty();
+}
+
+bool TrackSimulator::start()
+{
+  m_Start = m_LapStart = I2CSimulator::now();
+  m_Running = true;
+  if(pthread_create(&m_Thread, NULL, &TrackSimulator::threadMain, this) != 0) {
+    m_Running = false;
+  }
+  return m_Running;
+}
+
+void* TrackSimulator::threadMain(void* arg)
+{
+  static_cast<TrackSimulator*>(arg)->run();
+  return NULL;
+}
+
+void TrackSimulator::run()
+{
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+  while(m_Running) {
+    next.tv_nsec += PHYSICS_PERIOD_NS;
+    if(next.tv_nsec >= 1000000000) {
+      next.tv_nsec -= 1000000000;
+      next.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+    pthread_mutex_lock(&m_Mutex);
+    step(PHYSICS_PERIOD_NS / 1e9);
+    pthread_mutex_unlock(&m_Mutex);
+    updateSensors();
+    updateMice(next);
+  }
+}
+
+/* Segment intersection, returns the fraction along a where it crosses b or -1 */
+static double intersect(double ax1, double ay1, double ax2, double ay2,
+                        double bx1, double by1, double bx2, double by2)
+{
+  double dax = ax2 - ax1, day = ay2 - ay1;
+  double dbx = bx2 - bx1, dby = by2 - by1;
+  double denom = dax * dby - day * dbx;
+  if(fabs(denom) < 1e-9) {
+    return -1;
+  }
+  double t = ((bx1 - ax1) * dby - (by1 - ay1) * dbx) / denom;
+  double u = ((bx1 - ax1) * day - (by1 - ay1) * dax) / denom;
+  return (t >= 0 && t <= 1 && u >= 0 && u <= 1) ? t : -1;
+}
+
+void TrackSimulator::step(double dt)
+{
+  double steering = 0;
+  double throttle = 0;
+  SimulatedPCA9685* steeringPwm = m_Bus.getPCA9685(m_SteeringPwm);
+  SimulatedPCA9685* motorPwm = m_Bus.getPCA9685(m_MotorPwm);
+  m_Bus.lock();
+  int steeringPulse = steeringPwm ? steeringPwm->getPulse(m_SteeringChannel) : 0;
+  int motorPulse = motorPwm ? motorPwm->getPulse(m_MotorChannel) : 0;
+  m_Bus.unlock();
+
+  /* No pulse at all leaves the servo and ESC where they are */
+  if(steeringPulse) {
+    double center = (m_SteeringLeft + m_SteeringRight) / 2;
+    steering = std::max(-1.0, std::min(1.0, (steeringPulse - center) / ((m_SteeringLeft - m_SteeringRight) / 2)));
+  }
+  if(motorPulse) {
+    double neutral = (m_MotorForward + m_MotorReverse) / 2;
+    if(motorPulse > neutral) {
+      throttle = std::min(1.0, (motorPulse - neutral) / (m_MotorForward - neutral));
+    } else {
+      throttle = std::max(-1.0, (motorPulse - neutral) / (neutral - m_MotorReverse));
+    }
+  }
+
+  /* ESC: the first reverse command brakes, reverse only engages after neutral */
+  double target = 0;
+  double rate = m_Acceleration;
+  if(throttle > THROTTLE_DEADBAND) {
+    m_Braking = false;
+    m_ReverseArmed = false;
+    target = throttle * m_MaxSpeed;
+  } else if(throttle < -THROTTLE_DEADBAND) {
+    if(m_ReverseArmed) {
+      target = throttle * m_MaxSpeed;
+    } else {
+      m_Braking = true;
+      rate = m_BrakeDeceleration;
+    }
+  } else {
+    if(m_Braking || fabs(m_Speed) < STOPPED_SPEED) {
+      m_ReverseArmed = true;
+    }
+    m_Braking = false;
+  }
+  m_Speed += std::max(-rate * dt, std::min(rate * dt, target - m_Speed));
+
+  /* Kinematic bicycle model, left steering turns counter-clockwise */
+  double heading = m_Heading + m_Speed / m_WheelBase * tan(steering * m_MaxSteering) * dt;
+  double x = m_X + m_Speed * cos(heading) * dt;
+  double y = m_Y + m_Speed * sin(heading) * dt;
+
+  if(collides(x, y)) {
+    if(!m_InCollision) {
+      m_Collisions++;
+      m_InCollision = true;
+    }
+    m_Speed = 0;
+    m_DeltaHeading += heading - m_Heading;
+    m_Heading = heading;
+    return;
+  }
+  m_InCollision = false;
+
+  if(m_HasFinish && intersect(m_X, m_Y, x, y, m_Finish.x1, m_Finish.y1, m_Finish.x2, m_Finish.y2) >= 0) {
+    uint64_t now = I2CSimulator::now();
+    m_LapTimes.push_back((now - m_LapStart) / 1e9);
+    m_LapStart = now;
+    std::cerr << "Track simulator: lap " << m_LapTimes.size() << " in " << m_LapTimes.back() << " s, "
+              << m_Collisions << " collisions so far" << std::endl;
+  }
+
+  m_DeltaForward += m_Speed * dt;
+  m_DeltaHeading += heading - m_Heading;
+  m_Distance += fabs(m_Speed * dt);
+  m_X = x;
+  m_Y = y;
+  m_Heading = heading;
+}
+
+void TrackSimulator::updateSensors()
+{
+  pthread_mutex_lock(&m_Mutex);
+  std::vector<std::vector<uint16_t> > echoes(m_Ultrasonic.size());
+  for(size_t i = 0; i < m_Ultrasonic.size(); ++i) {
+    /* The SRF08 cone is about 55 degrees wide, sample the central part of it */
+    double ranges[SimulatedSRF08::MAX_ECHOES];
+    int count = castRays(m_Heading + m_Ultrasonic[i].angle, degreesToRadians(30), 7, ranges, SimulatedSRF08::MAX_ECHOES);
+    for(int j = 0; j < count; ++j) {
+      double range = ranges[j] + noise(1.0);
+      echoes[i].push_back((range < 3) ? 3 : (uint16_t)range);
+    }
+    /* Occasional ghost echo from crosstalk or the floor */
+    if(rand_r(&s_Seed) % 100 == 0) {
+      echoes[i].insert(echoes[i].begin(), 10 + rand_r(&s_Seed) % 40);
+    }
+  }
+  std::vector<double> millivolts(m_Infrared.size());
+  for(size_t i = 0; i < m_Infrared.size(); ++i) {
+    /* Inverse of the GP2Y0A02 curve, folding back below 20 cm and flat beyond 150 cm */
+    double range = std::min(castRay(m_Heading + m_Infrared[i].angle), 150.0);
+    double volts = pow(std::max(range, 20.0) / 65.0, -1.0 / 1.10);
+    if(range < 20) {
+      volts *= range / 20;
+    }
+    millivolts[i] = std::max(0.0, volts * 1000 * (1 + noise(0.01)) + noise(5));
+  }
+  pthread_mutex_unlock(&m_Mutex);
+
+  for(size_t i = 0; i < m_Ultrasonic.size(); ++i) {
+    SimulatedSRF08* srf08 = m_Bus.getSRF08(m_Ultrasonic[i].address);
+    if(srf08) {
+      m_Bus.lock();
+      srf08->setEchoes(echoes[i].empty() ? NULL : &echoes[i][0], echoes[i].size());
+      m_Bus.unlock();
+    }
+  }
+  for(size_t i = 0; i < m_Infrared.size(); ++i) {
+    SimulatedADS1115* adc = m_Bus.getADS1115(m_Infrared[i].address);
+    if(adc) {
+      m_Bus.lock();
+      adc->setInputMilliVolts(m_Infrared[i].channel, millivolts[i]);
+      m_Bus.unlock();
+    }
+  }
+}
+
+/* PS/2 packets as read from /dev/input/mice, forward motion gives negative y.
+   Evdev reports have the y axis the other way round. */
+void TrackSimulator::updateMice(const struct timespec& time)
+{
+  pthread_mutex_lock(&m_Mutex);
+  double distance = m_DeltaForward;
+  double turn = m_DeltaHeading;
+  m_DeltaForward = m_DeltaHeading = 0;
+  pthread_mutex_unlock(&m_Mutex);
+
+  for(size_t i = 0; i < m_Mice.size(); ++i) {
+    MouseSensor& mouse = m_Mice[i];
+    /* Motion of the mounting point in car coordinates, then in the mouse's own */
+    double carForward = distance - turn * mouse.y;
+    double carLeft = turn * mouse.x;
+    double forward = carForward * mouse.cos + carLeft * mouse.sin;
+    double left = -carForward * mouse.sin + carLeft * mouse.cos;
+    mouse.residualX -= left * m_CountsPerCm;
+    mouse.residualY -= forward * m_CountsPerCm;
+    if(++mouse.steps < mouse.interval) {
+      continue;
+    }
+    mouse.steps = 0;
+    int dx = (int)mouse.residualX;
+    int dy = (int)mouse.residualY;
+    if(!mouse.evdev) {
+      dx = std::max(-127, std::min(127, dx));
+      dy = std::max(-127, std::min(127, dy));
+    }
+    if(dx == 0 && dy == 0) {
+      continue;
+    }
+    mouse.residualX -= dx;
+    mouse.residualY -= dy;
+    bool written;
+    if(mouse.evdev) {
+      struct input_event events[3];
+      memset(events, 0, sizeof(events));
+      for(int j = 0; j < 3; ++j) {
+        events[j].time.tv_sec = time.tv_sec;
+        events[j].time.tv_usec = time.tv_nsec / 1000;
+      }
+      events[0].type = EV_REL;
+      events[0].code = REL_X;
+      events[0].value = dx;
+      events[1].type = EV_REL;
+      events[1].code = REL_Y;
+      events[1].value = -dy;
+      events[2].type = EV_SYN;
+      events[2].code = SYN_REPORT;
+      written = write(mouse.fd, events, sizeof(events)) == sizeof(events);
+    } else {
+      int8_t packet[3] = { (int8_t)(0x08 | ((dx < 0) ? 0x10 : 0) | ((dy < 0) ? 0x20 : 0)), (int8_t)dx, (int8_t)dy };
+      written = write(mouse.fd, packet, sizeof(packet)) == sizeof(packet);
+    }
+    if(!written) {
+      /* Nobody drains the FIFO, drop the motion */
+      mouse.residualX = mouse.residualY = 0;
+    }
+  }
+}
+
+/* Casts a fan of rays and returns the distinct wall distances, nearest first */
+int TrackSimulator::castRays(double angle, double spread, int rays, double* ranges, int max)
+{
+  std::vector<double> hits;
+  for(int i = 0; i < rays; ++i) {
+    double range = castRay(angle - spread / 2 + spread * i / (rays - 1));
+    if(range < MAX_RAY_RANGE) {
+      hits.push_back(range);
+    }
+  }
+  std::sort(hits.begin(), hits.end());
+  int count = 0;
+  for(size_t i = 0; i < hits.size() && count < max; ++i) {
+    if(count == 0 || hits[i] - ranges[count - 1] > 10) {
+      ranges[count++] = hits[i];
+    }
+  }
+  return count;
+}
+
+double TrackSimulator::castRay(double angle)
+{
+  double x2 = m_X + MAX_RAY_RANGE * cos(angle);
+  double y2 = m_Y + MAX_RAY_RANGE * sin(angle);
+  double nearest = MAX_RAY_RANGE;
+  for(size_t i = 0; i < m_Walls.size(); ++i) {
+    double t = intersect(m_X, m_Y, x2, y2, m_Walls[i].x1, m_Walls[i].y1, m_Walls[i].x2, m_Walls[i].y2);
+    if(t >= 0) {
+      nearest = std::min(nearest, t * MAX_RAY_RANGE);
+    }
+  }
+  return nearest;
+}
+
+bool TrackSimulator::collides(double x, double y)
+{
+  for(size_t i = 0; i < m_Walls.size(); ++i) {
+    const Segment& wall = m_Walls[i];
+    double dx = wall.x2 - wall.x1, dy = wall.y2 - wall.y1;
+    double length = dx * dx + dy * dy;
+    double t = (length > 0) ? std::max(0.0, std::min(1.0, ((x - wall.x1) * dx + (y - wall.y1) * dy) / length)) : 0;
+    double px = wall.x1 + t * dx - x, py = wall.y1 + t * dy - y;
+    if(px * px + py * py < m_Radius * m_Radius) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Gaussian noise by Box-Muller */
+double TrackSimulator::noise(double sigma)
+{
+  double u1 = (rand_r(&s_Seed) + 1.0) / (RAND_MAX + 2.0);
+  double u2 = (rand_r(&s_Seed) + 1.0) / (RAND_MAX + 2.0);
+  return sigma * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+void TrackSimulator::printStatistics(std::ostream& out)
+{
+  pthread_mutex_lock(&m_Mutex);
+  double elapsed = (I2CSimulator::now() - m_Start) / 1e9;
+  out << "Track: " << m_LapTimes.size() << " laps, " << m_Collisions << " collisions, "
+      << m_Distance / 100 << " m in " << elapsed << " s" << std::endl;
+  if(!m_LapTimes.empty()) {
+    out << "  best lap " << *std::min_element(m_LapTimes.begin(), m_LapTimes.end()) << " s" << std::endl;
+  }
+  pthread_mutex_unlock(&m_Mutex);
+}
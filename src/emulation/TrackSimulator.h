@@ -0,0 +1,129 @@
+#ifndef TRACK_SIMULATOR_H
+#define TRACK_SIMULATOR_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <vector>
+#include <string>
+#include <ostream>
+
+#include <boost/property_tree/ptree.hpp>
+
+class I2CSimulator;
+
+/* Closed-loop track world for EMULATE builds.
+
+   Enabled by pointing ROBOT_SIM_TRACK at a track file. The car is a
+   kinematic bicycle model driven by the steering and motor pulses the
+   robot writes to the simulated PCA9685, and every physics step the
+   simulated SRF08s and ADS1115 inputs are fed with ray-cast ranges from
+   the walls. Mouse speed sensors get PS/2 packets at 100 Hz through a
+   FIFO created at their configured device path, evdev ones get
+   input_event reports at 1 kHz with CLOCK_MONOTONIC timestamps. Each
+   mouse sees the motion at its mounting position and orientation, so
+   the ones away from the rear axle also pick up the yaw.
+
+   Track file, one item per line, lengths in cm, angles in degrees:
+     wall x1 y1 x2 y2
+     start x y heading
+     finish x1 y1 x2 y2
+
+   Sensor angles follow the mounting on the car: SRF08 angles go clockwise
+   from straight ahead, analog sensor angles counter-clockwise from the
+   right-hand side. Car parameters can be tuned in an optional
+   "robot.simulation" section of the configuration. */
+class TrackSimulator
+{
+ public:
+  TrackSimulator(I2CSimulator& bus, const boost::property_tree::ptree& cfg);
+  ~TrackSimulator();
+
+  bool loadTrack(const char* file);
+  bool start();
+
+  void printStatistics(std::ostream& out);
+
+ private:
+  struct Segment
+  {
+    double x1, y1, x2, y2;
+  };
+
+  struct RangeSensor
+  {
+    uint8_t address;
+    int channel;
+    double angle;
+  };
+
+  struct MouseSensor
+  {
+    int fd;
+    bool evdev;
+    int interval;
+    int steps;
+    double x;
+    double y;
+    double cos;
+    double sin;
+    double residualX;
+    double residualY;
+  };
+
+  static void* threadMain(void* arg);
+  void run();
+  void step(double dt);
+  void updateSensors();
+  void updateMice(const struct timespec& time);
+
+  int castRays(double angle, double spread, int rays, double* ranges, int max);
+  double castRay(double angle);
+  bool collides(double x, double y);
+  double noise(double sigma);
+
+  I2CSimulator& m_Bus;
+  std::vector<Segment> m_Walls;
+  Segment m_Finish;
+  bool m_HasFinish;
+
+  std::vector<RangeSensor> m_Ultrasonic;
+  std::vector<RangeSensor> m_Infrared;
+  std::vector<MouseSensor> m_Mice;
+
+  uint8_t m_SteeringPwm;
+  int m_SteeringChannel;
+  double m_SteeringLeft;
+  double m_SteeringRight;
+  uint8_t m_MotorPwm;
+  int m_MotorChannel;
+  double m_MotorForward;
+  double m_MotorReverse;
+
+  double m_WheelBase;
+  double m_Radius;
+  double m_MaxSteering;
+  double m_MaxSpeed;
+  double m_Acceleration;
+  double m_BrakeDeceleration;
+  double m_CountsPerCm;
+
+  double m_X;
+  double m_Y;
+  double m_Heading;
+  double m_Speed;
+  double m_DeltaForward;
+  double m_DeltaHeading;
+  bool m_Braking;
+  bool m_ReverseArmed;
+  bool m_InCollision;
+
+  pthread_t m_Thread;
+  pthread_mutex_t m_Mutex;
+  bool m_Running;
+  uint64_t m_Start;
+  uint64_t m_LapStart;
+  int m_Collisions;
+  double m_Distance;
+  std::vector<double> m_LapTimes;
+};
+#endif
@@ -4,8 +4,38 @@
 #define HIGH 0
 #define LOW 0
 
+#define INT_EDGE_SETUP 0
+#define INT_EDGE_FALLING 1
+#define INT_EDGE_RISING 2
+#define INT_EDGE_BOTH 3
+
+#define EMULATED_GPIO_PINS 64
+
 inline void wiringPiSetupGpio() { }
 inline void pinMode(int, int) { }
 inline void digitalWrite(int, int) { }
 inline int digitalRead(int) { return 0; }
 inline void pullUpDnControl(int, int) { }
+
+inline void (**emulatedIsrTable())(void)
+{
+  static void (*table[EMULATED_GPIO_PINS])(void);
+  return table;
+}
+
+inline int wiringPiISR(int pin, int, void (*function)(void))
+{
+  if(pin < 0 || pin >= EMULATED_GPIO_PINS) {
+    return -1;
+  }
+  emulatedIsrTable()[pin] = function;
+  return 0;
+}
+
+/* Simulate an edge on a GPIO, runs the handler installed by wiringPiISR() */
+inline void emulateInterrupt(int pin)
+{
+  if(pin >= 0 && pin < EMULATED_GPIO_PINS && emulatedIsrTable()[pin]) {
+    emulatedIsrTable()[pin]();
+  }
+}
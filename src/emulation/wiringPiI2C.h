@@ -1,7 +1,11 @@
-inline int wiringPiI2CSetup(uint8_t addr) { return 0; }
-inline int wiringPiI2CWriteReg8(int fd, uint8_t reg, uint8_t val) { return 0; }
-inline int wiringPiI2CReadReg8(int fd, uint8_t reg) { return 0; }
-inline int wiringPiI2CReadBlockData (int fd, int reg, int length, uint8_t* values) { return 0; }
-inline int wiringPiI2CWriteReg16(int fd, uint8_t reg, uint16_t val) { return 0; }
-inline int wiringPiI2CReadReg16(int fd, uint8_t reg) { return 0; }
-inline int wiringPiI2CWriteBlockData (int fd, int reg, int length, uint8_t* values) { return 0; }
+#include <stdint.h>
+
+/* Backed by the register-level bus simulator in I2CSimulator.cpp. Return
+   values follow the real library: -1 when the device does not acknowledge. */
+int wiringPiI2CSetup(uint8_t addr);
+int wiringPiI2CWriteReg8(int fd, uint8_t reg, uint8_t val);
+int wiringPiI2CReadReg8(int fd, uint8_t reg);
+int wiringPiI2CReadBlockData (int fd, int reg, int length, uint8_t* values);
+int wiringPiI2CWriteReg16(int fd, uint8_t reg, uint16_t val);
+int wiringPiI2CReadReg16(int fd, uint8_t reg);
+int wiringPiI2CWriteBlockData (int fd, int reg, int length, uint8_t* values);